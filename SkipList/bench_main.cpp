@@ -0,0 +1,119 @@
+/*
+ * Program entry point for skiplist_bench, runs the benchmark engine from command line flags and prints the results as
+ * CSV or JSON for scripts and parameter sweeps.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+
+
+namespace
+{
+	void usage(std::ostream& os)
+	{
+		os << "Usage: skiplist_bench [options]\n"
+			"  --n N                 calls per operation (default 100000)\n"
+			"  --repetitions R       timed runs averaged per result (default 3)\n"
+			"  --structures a,b,...  structures to time, or all (default skip_list)\n"
+			"  --operations a,b,...  operations to time, or all (default all)\n"
+			"  --p P                 promotion probability of the skip lists and skip map (default 0.5)\n"
+			"  --seed S              fixes the key order and tower heights (default random)\n"
+			"  --format csv|json     output format (default csv)\n"
+			"  --verbose             write progress to stderr\n"
+			"  --help                show this message\n"
+			"\nStructures:";
+		for (const auto& structure : benchmark_structures()) os << ' ' << structure;
+		os << "\nOperations:";
+		for (const auto& operation : benchmark_operations()) os << ' ' << operation;
+		os << std::endl;
+	}
+
+	// splits a comma separated list, all stands for every entry of every
+	std::vector<std::string> split(const std::string& list, const std::vector<std::string>& every)
+	{
+		if (list == "all") return every;
+
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		for (std::string item; std::getline(stream, item, ',');)
+			if (!item.empty()) items.push_back(item);
+		return items;
+	}
+
+	// parses the whole of text as a T, throws std::invalid_argument if it isn't one
+	template <typename T>
+	T parse(const std::string& flag, const std::string& text)
+	{
+		// streams read a negative number into an unsigned type by wrapping it around
+		if (std::is_unsigned<T>::value && text.find('-') != std::string::npos)
+			throw std::invalid_argument("invalid value " + text + " for " + flag);
+
+		std::istringstream stream(text);
+		T value;
+		if (!(stream >> value) || !stream.eof()) throw std::invalid_argument("invalid value " + text + " for " + flag);
+		return value;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	benchmark_options options;
+	bool json = false;
+	bool verbose = false;
+
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string flag = argv[i];
+			if (flag == "--help")
+			{
+				usage(std::cout);
+				return 0;
+			}
+			if (flag == "--verbose")
+			{
+				verbose = true;
+				continue;
+			}
+
+			if (i + 1 == argc) throw std::invalid_argument("missing value for " + flag);
+			const std::string value = argv[++i];
+
+			if (flag == "--n") options.n = parse<long long>(flag, value);
+			else if (flag == "--repetitions") options.repetitions = parse<unsigned>(flag, value);
+			else if (flag == "--structures") options.structures = split(value, benchmark_structures());
+			else if (flag == "--operations") options.operations = split(value, benchmark_operations());
+			else if (flag == "--p") options.p = parse<float>(flag, value);
+			else if (flag == "--seed") options.seed = parse<std::uint64_t>(flag, value);
+			else if (flag == "--format")
+			{
+				if (value != "csv" && value != "json") throw std::invalid_argument("unknown format " + value);
+				json = value == "json";
+			}
+			else throw std::invalid_argument("unknown option " + flag);
+		}
+
+		if (!(options.p > 0 && options.p < 1)) throw std::invalid_argument("p must be between 0 and 1");
+
+		const auto results = run_benchmark(options, verbose ? &std::cerr : nullptr);
+		if (json) write_json(std::cout, results);
+		else write_csv(std::cout, results);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << "skiplist_bench: " << e.what() << "\n\n";
+		usage(std::cerr);
+		return EXIT_FAILURE;
+	}
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Benchmark engine timing the sorted lists, see benchmark.h.
+ */
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "blocked_skip_list_test.h"
+#include "skip_list_pool.h"
+#include "skip_list_test.h"
+#include "skip_map.h"
+#include "sorted_linked_list.h"
+#include "sorted_map.h"
+#include "sorted_vector.h"
+#include "test_class.h"
+
+
+namespace
+{
+	// keys are multiples of multiplier, the lists are filled with every key up to n * multiplier
+	constexpr long long multiplier = 5;
+
+	/*
+	 * returns a new empty list for the structure key, throws std::invalid_argument if there is no such structure
+	 */
+	std::unique_ptr<sorted_list<test_class>> make_list(const std::string& structure, const float p, const std::uint64_t seed)
+	{
+		if (structure == "skip_list")
+			return std::make_unique<skip_list_test<test_class>>(p, seed);
+		if (structure == "pooled_skip_list")
+			return std::make_unique<skip_list_test<test_class, skip_list_pool_allocator<test_class>>>(p, seed, "pooled skip list");
+		if (structure == "blocked_skip_list")
+			return std::make_unique<blocked_skip_list_test<test_class>>(p, seed);
+		if (structure == "skip_map")
+			return std::make_unique<sorted_map<skip_map<test_class, test_class>>>("skip map", p, seed);
+		if (structure == "std_map")
+			return std::make_unique<sorted_map<std::map<test_class, test_class>>>("std::map");
+		if (structure == "linked_list")
+			return std::make_unique<sorted_linked_list<test_class>>();
+		if (structure == "vector")
+			return std::make_unique<sorted_vector<test_class>>();
+		throw std::invalid_argument("unknown structure " + structure);
+	}
+
+	/*
+	 * Gets time in nanoseconds to run function() averaged over a number of repetitions, logging each run like time() in
+	 * the interactive tests. before() is called prior to timing function() for any needed setup.
+	 */
+	double time_runs(const std::string& message, const std::function<void()>& before, const std::function<void()>& function,
+		const unsigned repetitions, std::ostream* log)
+	{
+		if (log) *log << message << " (" << repetitions << " repetitions)" << std::endl;
+
+		double total = 0;
+		for (unsigned i = 0; i < repetitions; ++i)
+		{
+			before();
+
+			const auto start = std::chrono::steady_clock::now();
+			function();
+			const auto stop = std::chrono::steady_clock::now();
+			const auto t = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+
+			if (log) *log << "                      time: " << t / 1000 << " microseconds" << std::endl;
+			total += static_cast<double>(t);
+		}
+
+		const auto average = total / repetitions;
+		if (log) *log << "    Average execution time: " << static_cast<long long>(average / 1000) << " microseconds" << std::endl;
+		return average;
+	}
+}
+
+const std::vector<std::string>& benchmark_structures()
+{
+	static const std::vector<std::string> structures
+		{ "skip_list", "pooled_skip_list", "blocked_skip_list", "skip_map", "std_map", "linked_list", "vector" };
+	return structures;
+}
+
+const std::vector<std::string>& benchmark_operations()
+{
+	static const std::vector<std::string> operations { "insert", "remove", "contains" };
+	return operations;
+}
+
+std::string benchmark_call_name(const std::string& operation)
+{
+	if (operation == "insert") return "Insert()";
+	if (operation == "remove") return "Remove()";
+	return "Contains()";
+}
+
+/*
+ * Builds every structure once, then times each operation on each of them in turn. The keys are reshuffled before every
+ * run from a single generator, so a fixed seed repeats the whole sequence of runs.
+ */
+std::vector<benchmark_result> run_benchmark(const benchmark_options& options, std::ostream* log)
+{
+	if (options.n <= 0) throw std::invalid_argument("n must be positive");
+	if (options.repetitions == 0) throw std::invalid_argument("repetitions must be positive");
+	for (const auto& operation : options.operations)
+		if (std::find(benchmark_operations().begin(), benchmark_operations().end(), operation) == benchmark_operations().end())
+			throw std::invalid_argument("unknown operation " + operation);
+
+	const std::uint64_t seed = options.seed ? *options.seed
+		: (static_cast<std::uint64_t>(std::random_device()()) << 32) ^ std::random_device()();
+	std::mt19937_64 g(seed);
+
+	std::vector<std::unique_ptr<sorted_list<test_class>>> lists;
+	lists.reserve(options.structures.size());
+	for (const auto& structure : options.structures) lists.push_back(make_list(structure, options.p, seed));
+
+	const long long n = options.n;
+	const long long n_existing = n * multiplier;
+	std::vector<unsigned long long> input(n);
+	for (long long i = 0; i < n; ++i) input[i] = i * multiplier;
+
+	std::vector<benchmark_result> results;
+	for (const auto& operation : options.operations)
+	{
+		const auto call = benchmark_call_name(operation);
+		if (log)
+		{
+			*log << "\n -----------------------------------------------------------------------------------------------------" << std::endl;
+			*log << "\n Testing " << call << " for";
+			for (const auto& list : lists) *log << " { " << list->GetName() << " }";
+			if (operation == "insert")
+				*log << " by\n inserting " << n << " elements in random order into a list containing " << n_existing << " elements." << std::endl;
+			else
+				*log << " by\n calling " << call << " with " << n << " elements on a list containing " << n_existing / 2 << " elements." <<
+					"\n 50% of calls will be misses. " << std::endl;
+		}
+
+		// Contains() doesn't change the lists, so they are only filled once
+		if (operation == "contains")
+			for (const auto& list : lists) list->Fill(n_existing / 4, n_existing * 3/4);
+
+		for (unsigned i = 0; i < lists.size(); ++i)
+		{
+			auto& list = *lists[i];
+			const auto nanoseconds = time_runs(
+				"\n  Testing " + call + " for " + list.GetName(),
+				[&]
+				{
+					// refill list, all of it for Insert() and only the middle elements for Remove()
+					if (operation == "insert") list.Fill(0, n_existing);
+					else if (operation == "remove") list.Fill(n_existing / 4, n_existing * 3/4);
+
+					// shuffle input
+					std::shuffle(input.begin(), input.end(), g);
+				},
+				[&]
+				{
+					if (operation == "insert") for (const auto key : input) list.Insert(key);
+					else if (operation == "remove") for (const auto key : input) list.Remove(key);
+					else for (const auto key : input) list.Contains(key);
+				},
+				options.repetitions, log);
+
+			const double ns_per_op = nanoseconds / static_cast<double>(n);
+			results.push_back({ options.structures[i], list.GetName(), operation, n, options.repetitions, options.p, seed,
+				nanoseconds, ns_per_op, ns_per_op > 0 ? 1e9 / ns_per_op : 0 });
+		}
+	}
+
+	return results;
+}
+
+void write_csv(std::ostream& os, const std::vector<benchmark_result>& results)
+{
+	os << "structure,operation,n,repetitions,p,seed,ns_per_op,ops_per_sec\n";
+	for (const auto& result : results)
+		os << result.structure << ',' << result.operation << ',' << result.n << ',' << result.repetitions << ',' << result.p << ','
+			<< result.seed << ',' << result.ns_per_op << ',' << static_cast<long long>(result.ops_per_sec) << '\n';
+}
+
+void write_json(std::ostream& os, const std::vector<benchmark_result>& results)
+{
+	os << "[\n";
+	for (unsigned i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+		os << "  {\"structure\": \"" << result.structure << "\", \"name\": \"" << result.name << "\", \"operation\": \""
+			<< result.operation << "\", \"n\": " << result.n << ", \"repetitions\": " << result.repetitions << ", \"p\": " << result.p
+			<< ", \"seed\": " << result.seed << ", \"ns_per_op\": " << result.ns_per_op << ", \"ops_per_sec\": "
+			<< static_cast<long long>(result.ops_per_sec) << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+	}
+	os << "]\n";
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * Benchmark engine timing Insert(), Remove(), and Contains() on the sorted lists, shared by the interactive performance
+ * test and the skiplist_bench command line driver.
+ *
+ * Each operation is called with n keys in random order. Insert() runs on a list holding every key from 0 to 5n, so
+ * every call inserts a duplicate next to an existing element, Remove() and Contains() run on a list holding the middle
+ * half of those keys, so half of the calls miss.
+ */
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+struct benchmark_options
+{
+	long long n = 100000;                       // number of calls per operation
+	unsigned repetitions = 3;                   // timed runs per structure and operation, averaged
+	std::vector<std::string> structures { "skip_list" };
+	std::vector<std::string> operations { "insert", "remove", "contains" };
+	float p = 0.5f;                             // promotion probability of the skip lists and skip map
+	std::optional<std::uint64_t> seed;          // fixes the key order and skip list tower heights, random if empty
+};
+
+struct benchmark_result
+{
+	std::string structure;                      // key of the structure, as in benchmark_structures()
+	std::string name;                           // GetName() of the structure
+	std::string operation;
+	long long n;
+	unsigned repetitions;
+	float p;
+	std::uint64_t seed;
+	double nanoseconds;                         // average time of one run of n calls
+	double ns_per_op;
+	double ops_per_sec;
+};
+
+// returns the keys of the structures run_benchmark() can time
+const std::vector<std::string>& benchmark_structures();
+
+// returns the operations run_benchmark() can time
+const std::vector<std::string>& benchmark_operations();
+
+// returns the name of the list method timed by operation, Insert() for insert
+std::string benchmark_call_name(const std::string& operation);
+
+// times every operation on every structure in options, in order, writing progress to log if it isn't null.
+// Throws std::invalid_argument for an unknown structure or operation, or n or repetitions of 0
+std::vector<benchmark_result> run_benchmark(const benchmark_options& options, std::ostream* log = nullptr);
+
+// writes results as CSV with a header row
+void write_csv(std::ostream& os, const std::vector<benchmark_result>& results);
+
+// writes results as a JSON array of objects
+void write_json(std::ostream& os, const std::vector<benchmark_result>& results);
@@ -0,0 +1,625 @@
+/*
+ * Blocked (unrolled) skip list.
+ *
+ * Same idea as skip_list, but each node holds a small sorted array of keys (sized to one or two cache lines) instead of a
+ * single key. The express lanes index blocks by their first key, so a search walks a much shorter chain of nodes and
+ * finishes with a scan of one contiguous block. Blocks split in half when full and merge with their successor when
+ * they fall below a quarter full. For arithmetic keys the search inside a block uses the SIMD kernels in skip_list_simd.h.
+ *
+ * Works with any type T that defines < operator.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "skip_list_level.h"
+#include "skip_list_simd.h"
+
+
+/* default number of keys per block, filling two 64 byte cache lines (at least 4 keys) */
+template <typename T>
+constexpr unsigned blocked_skip_list_block_size() { return 128 / sizeof(T) > 4 ? static_cast<unsigned>(128 / sizeof(T)) : 4; }
+
+
+/*
+ * Block node for use with blocked_skip_list. Holds up to BlockSize sorted keys followed by an inline array of height
+ * forward links (one for each layer the block is part of).
+ */
+template <typename T, unsigned BlockSize>
+struct blocked_skip_list_node
+{
+    explicit blocked_skip_list_node(unsigned height) : count(0), height(height)
+    {
+        for (unsigned i = 0; i < height; ++i) next(i) = nullptr;
+    }
+
+    ~blocked_skip_list_node() { for (unsigned i = 0; i < count; ++i) key(i).~T(); }
+
+    blocked_skip_list_node(const blocked_skip_list_node&) = delete;
+    blocked_skip_list_node& operator=(const blocked_skip_list_node&) = delete;
+
+    unsigned count;     // number of keys in the block
+    unsigned height;    // number of layers this block is linked into
+
+    T& key(unsigned i) { return *std::launder(reinterpret_cast<T*>(storage_) + i); }
+    const T& key(unsigned i) const { return *std::launder(reinterpret_cast<const T*>(storage_) + i); }
+
+    // returns pointers to the first and one past the last key
+    const T* begin() const { return &key(0); }
+    const T* end() const { return &key(0) + count; }
+
+    // returns the position of the first key not less than val
+    unsigned LowerBound(const T& val) const;
+
+    // returns the position of the first key greater than val
+    unsigned UpperBound(const T& val) const;
+
+    // forward link of this block in layer
+    blocked_skip_list_node*& next(unsigned layer) { return links()[layer]; }
+    blocked_skip_list_node* next(unsigned layer) const { return links()[layer]; }
+
+    // inserts val at position pos, shifting later keys right. Block must not be full
+    void InsertAt(unsigned pos, const T& val);
+
+    // removes the key at position pos, shifting later keys left
+    void EraseAt(unsigned pos);
+
+    // moves the keys from position from onwards to the end of other
+    void MoveTo(unsigned from, blocked_skip_list_node& other);
+
+    // number of bytes used by a block with height links
+    static constexpr size_t Bytes(unsigned height)
+    {
+        return sizeof(blocked_skip_list_node) + height * sizeof(blocked_skip_list_node*);
+    }
+
+private:
+    alignas(T) alignas(void*) unsigned char storage_[BlockSize * sizeof(T)];
+
+    // links are stored directly after the block in the same allocation
+    blocked_skip_list_node** links() { return reinterpret_cast<blocked_skip_list_node**>(this + 1); }
+    blocked_skip_list_node* const* links() const { return reinterpret_cast<blocked_skip_list_node* const*>(this + 1); }
+};
+
+template <typename T, unsigned BlockSize>
+unsigned blocked_skip_list_node<T, BlockSize>::LowerBound(const T& val) const
+{
+    if constexpr (std::is_arithmetic<T>::value) return skip_list_simd::CountLess(begin(), count, val);
+    else return static_cast<unsigned>(std::lower_bound(begin(), end(), val) - begin());
+}
+
+template <typename T, unsigned BlockSize>
+unsigned blocked_skip_list_node<T, BlockSize>::UpperBound(const T& val) const
+{
+    if constexpr (std::is_arithmetic<T>::value) return skip_list_simd::CountLessEqual(begin(), count, val);
+    else return static_cast<unsigned>(std::upper_bound(begin(), end(), val) - begin());
+}
+
+template <typename T, unsigned BlockSize>
+void blocked_skip_list_node<T, BlockSize>::InsertAt(const unsigned pos, const T& val)
+{
+    assert(count < BlockSize && pos <= count);
+
+    if (pos == count)
+    {
+        new (storage_ + count * sizeof(T)) T(val);
+    }
+    else
+    {
+        new (storage_ + count * sizeof(T)) T(std::move(key(count - 1)));
+        for (unsigned i = count - 1; i > pos; --i) key(i) = std::move(key(i - 1));
+        key(pos) = val;
+    }
+    ++count;
+}
+
+template <typename T, unsigned BlockSize>
+void blocked_skip_list_node<T, BlockSize>::EraseAt(const unsigned pos)
+{
+    assert(pos < count);
+
+    for (unsigned i = pos + 1; i < count; ++i) key(i - 1) = std::move(key(i));
+    key(--count).~T();
+}
+
+template <typename T, unsigned BlockSize>
+void blocked_skip_list_node<T, BlockSize>::MoveTo(const unsigned from, blocked_skip_list_node& other)
+{
+    assert(other.count + (count - from) <= BlockSize);
+
+    for (unsigned i = from; i < count; ++i)
+    {
+        new (other.storage_ + other.count++ * sizeof(T)) T(std::move(key(i)));
+        key(i).~T();
+    }
+    count = from;
+}
+
+
+/*
+ * Blocked skip list. Keys are stored in sorted blocks of up to BlockSize keys, layers_ holds the first block of each
+ * layer. Blocks are randomly promoted to higher layers in the same way as skip_list promotes elements.
+ */
+template <typename T, unsigned BlockSize = blocked_skip_list_block_size<T>()>
+class blocked_skip_list
+{
+    static_assert(BlockSize >= 2, "blocks must be able to split");
+
+public:
+    // Constructor, block levels are generated from a random seed
+    blocked_skip_list(float p = 0.5);
+
+    // Constructor, block levels are generated from seed so the structure is reproducible
+    blocked_skip_list(float p, std::uint64_t seed);
+
+    // Copy constructor
+    blocked_skip_list(const blocked_skip_list& other);
+
+    // Move constructor
+    blocked_skip_list(blocked_skip_list&& other) noexcept;
+
+    // Assignment
+    blocked_skip_list& operator=(const blocked_skip_list& other);
+
+    // Move assignment
+    blocked_skip_list& operator=(blocked_skip_list&& other) noexcept;
+
+    // Destructor
+    ~blocked_skip_list() { Clear(); }
+
+    // returns true if list contains val
+    bool Contains(const T& val) const;
+
+    // insert val into its sorted position in the list
+    void Insert(const T& val);
+
+    // remove val from list, returns false if val not in list
+    bool Remove(const T& val);
+
+    // removes all elements form the list
+    void Clear();
+
+    // returns the number of elements in the list
+    size_t Size() const { return size_; }
+
+    // returns the number of blocks in the list
+    size_t Blocks() const { return blocks_; }
+
+    // returns the number of layers in the list
+    size_t Layers() const { return layers_.size(); }
+
+    // print the list to standard output. If internal_representation is true, all layers will be displayed
+    void Print(bool internal_rep = false) const;
+
+    // returns the number of bytes used by the blocks and layer heads of the list
+    size_t MemoryUsage() const;
+
+private:
+    typedef blocked_skip_list_node<T, BlockSize> node;
+
+    // upper bound on the number of layers, towers are capped at log_1/p(blocks) + 1
+    static constexpr unsigned max_height = 64;
+
+    std::vector<node*> layers_;
+    size_t size_;
+    size_t blocks_;
+    skip_list_level_generator generator_;
+
+    // returns the last block whose first key is <= val, or null if val is smaller than every key. If up is given, it
+    // receives the last such block in every layer (null meaning the start of the layer)
+    node* FindBlock(const T& val, node** up = nullptr) const;
+
+    // fills up with the block before target in each layer target is part of. min must be target's first key
+    void FindPredecessors(const node* target, const T& min, node** up) const;
+
+    // links block into each of its layers after the blocks in up, adding new layers if needed
+    void Link(node* block, node* const* up);
+
+    // unlinks block from each of its layers, up holding its predecessors
+    void Unlink(node* block, node* const* up);
+
+    // randomly picks the height of a new block (probability of each higher layer based on p)
+    unsigned RandomHeight();
+
+    static node* CreateBlock(unsigned height);
+    static void DestroyBlock(node* block);
+
+
+    // forward read only iterator
+public:
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        explicit iterator(node* block, unsigned index = 0) : block_(block), index_(index) {}
+
+        const T& operator*() const { return block_->key(index_); }
+        const T* operator->() const { return &block_->key(index_); }
+
+        // Prefix increment
+        iterator& operator++()
+        {
+            if (++index_ == block_->count)
+            {
+                block_ = block_->next(0);
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.block_ == b.block_ && a.index_ == b.index_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return !(a == b); }
+
+    private:
+        node* block_;
+        unsigned index_;
+    };
+
+    iterator begin() const { return iterator(!layers_.empty() ? layers_.front() : nullptr); }
+
+    iterator end() const { return iterator(nullptr); }
+};
+
+
+/* Blocked Skip List. p is the probability (must be in range [0,1]) that a new block will be inserted into a higher layer. */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>::blocked_skip_list(float p) : size_(0), blocks_(0), generator_(p)
+{
+    assert(p >= 0 && p <= 1);
+}
+
+/* Blocked Skip List with block levels generated from seed. */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>::blocked_skip_list(float p, std::uint64_t seed) : size_(0), blocks_(0), generator_(p, seed)
+{
+    assert(p >= 0 && p <= 1);
+}
+
+/* Copy constructor */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>::blocked_skip_list(const blocked_skip_list& other) : size_(0), blocks_(0), generator_(other.generator_)
+{
+    for (const auto& val : other) Insert(val);
+}
+
+/* Move copy constructor */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>::blocked_skip_list(blocked_skip_list&& other) noexcept
+    : layers_(std::move(other.layers_)), size_(other.size_), blocks_(other.blocks_), generator_(other.generator_)
+{
+    other.layers_.clear();
+    other.size_ = other.blocks_ = 0;
+}
+
+/* Assignment */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>& blocked_skip_list<T, BlockSize>::operator=(const blocked_skip_list& other)
+{
+    if (this == &other)
+        return *this;
+    Clear();
+    generator_ = other.generator_;
+    for (const auto& val : other) Insert(val);
+    return *this;
+}
+
+/* Move Assignment */
+template <typename T, unsigned BlockSize>
+blocked_skip_list<T, BlockSize>& blocked_skip_list<T, BlockSize>::operator=(blocked_skip_list&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    Clear();
+    layers_ = std::move(other.layers_);
+    size_ = other.size_;
+    blocks_ = other.blocks_;
+    generator_ = other.generator_;
+    other.layers_.clear();
+    other.size_ = other.blocks_ = 0;
+    return *this;
+}
+
+/*
+ * returns true if val is in the list, false otherwise
+ */
+template <typename T, unsigned BlockSize>
+bool blocked_skip_list<T, BlockSize>::Contains(const T& val) const
+{
+    const auto block = FindBlock(val);
+    if (!block) return false;
+
+    const auto pos = block->LowerBound(val);
+    return pos != block->count && !(val < block->key(pos));
+}
+
+/*
+ * Inserts val in its sorted position in the list, splitting its block in half if it is full
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::Insert(const T& val)
+{
+    // first element
+    if (layers_.empty())
+    {
+        auto block = CreateBlock(1);
+        block->InsertAt(0, val);
+        layers_.push_back(block);
+        ++blocks_;
+        ++size_;
+        return;
+    }
+
+    node* up[max_height];
+    auto block = FindBlock(val, up);
+
+    // smaller than every key, goes to the front of the first block
+    if (!block)
+    {
+        block = layers_.front();
+        for (unsigned layer = 0; layer < block->height; ++layer) up[layer] = block;
+    }
+
+    // insert after any equal keys
+    auto pos = block->UpperBound(val);
+
+    // split full block, moving its upper half into a new block linked directly after it
+    if (block->count == BlockSize)
+    {
+        ++blocks_;
+        auto sibling = CreateBlock(RandomHeight());
+        block->MoveTo(BlockSize / 2, *sibling);
+        Link(sibling, up);
+
+        if (pos > BlockSize / 2)
+        {
+            block = sibling;
+            pos -= BlockSize / 2;
+        }
+    }
+
+    block->InsertAt(pos, val);
+    ++size_;
+}
+
+/*
+ * removes the first element matching val from the list, merging its block with the next one if it gets too small.
+ * returns true if successful, false if val isn't in the list.
+ */
+template <typename T, unsigned BlockSize>
+bool blocked_skip_list<T, BlockSize>::Remove(const T& val)
+{
+    auto block = FindBlock(val);
+    if (!block) return false;
+
+    const auto pos = block->LowerBound(val);
+    if (pos == block->count || val < block->key(pos)) return false;
+
+    block->EraseAt(pos);
+    --size_;
+
+    if (block->count > BlockSize / 4) return true;
+
+    node* up[max_height];
+    auto next = block->next(0);
+
+    // merge the following block into this one if they fit in a single block
+    if (next && block->count + next->count <= BlockSize)
+    {
+        FindPredecessors(next, next->key(0), up);
+        next->MoveTo(0, *block);
+        Unlink(next, up);
+        DestroyBlock(next);
+        --blocks_;
+    }
+
+    // drop an empty last block
+    else if (block->count == 0)
+    {
+        FindPredecessors(block, val, up);
+        Unlink(block, up);
+        DestroyBlock(block);
+        --blocks_;
+    }
+
+    return true;
+}
+
+/*
+ * Removes all elements from the list.
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::Clear()
+{
+    // every block is linked into the bottom layer
+    auto block = layers_.empty() ? nullptr : layers_.front();
+    while (block)
+    {
+        auto next = block->next(0);
+        DestroyBlock(block);
+        block = next;
+    }
+
+    layers_.clear();
+    size_ = blocks_ = 0;
+}
+
+/*
+ * Prints the list.
+ * Prints all layers (showing the first key of each block above the bottom layer) if internal_rep is true,
+ * otherwise only the keys of the bottom layer are displayed.
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::Print(const bool internal_rep) const
+{
+    if (internal_rep && size_ == 0) std::cout << " Empty" << std::endl;
+
+    const auto n = internal_rep ? layers_.size() : std::min<size_t>(1, layers_.size());
+    for (auto i = n; i-- > 0;)
+    {
+        if (internal_rep) std::cout << " Layer " << i << ":";
+
+        for (auto block = layers_[i]; block; block = block->next(i))
+        {
+            if (i > 0)
+            {
+                std::cout << " " << block->key(0);
+                continue;
+            }
+
+            std::cout << " [";
+            for (unsigned k = 0; k < block->count; ++k) std::cout << (k ? " " : "") << block->key(k);
+            std::cout << "]";
+        }
+        std::cout << std::endl;
+    }
+    if (internal_rep) std::cout << " Size: " << size_ << " Blocks: " << blocks_ << std::endl;
+    std::cout << std::endl;
+}
+
+/*
+ * Returns the number of bytes used by all blocks plus the layer head vector.
+ */
+template <typename T, unsigned BlockSize>
+size_t blocked_skip_list<T, BlockSize>::MemoryUsage() const
+{
+    size_t bytes = layers_.capacity() * sizeof(node*);
+    for (auto block = layers_.empty() ? nullptr : layers_.front(); block; block = block->next(0))
+        bytes += node::Bytes(block->height);
+    return bytes;
+}
+
+/*
+ * Searches each layer from the highest for the last block whose first key is <= val.
+ * returns null if the list is empty or val is smaller than the first key.
+ */
+template <typename T, unsigned BlockSize>
+typename blocked_skip_list<T, BlockSize>::node* blocked_skip_list<T, BlockSize>::FindBlock(const T& val, node** up) const
+{
+    node* current = nullptr;
+
+    for (auto layer = layers_.size(); layer-- > 0;)
+    {
+        auto next = current ? current->next(layer) : layers_[layer];
+        while (next && !(val < next->key(0)))
+        {
+            current = next;
+            next = next->next(layer);
+        }
+        if (up) up[layer] = current;
+    }
+
+    return current;
+}
+
+/*
+ * Finds the block before target in every layer. Searches for the last blocks with a first key < min, then walks forward
+ * past any blocks starting with a key equal to min until reaching target.
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::FindPredecessors(const node* target, const T& min, node** up) const
+{
+    node* current = nullptr;
+
+    for (auto layer = layers_.size(); layer-- > 0;)
+    {
+        auto next = current ? current->next(layer) : layers_[layer];
+        while (next && next != target && next->key(0) < min)
+        {
+            current = next;
+            next = next->next(layer);
+        }
+        up[layer] = current;
+    }
+
+    for (unsigned layer = 0; layer < target->height; ++layer)
+    {
+        auto next = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        while (next != target)
+        {
+            up[layer] = next;
+            next = next->next(layer);
+        }
+    }
+}
+
+/*
+ * Links block after the blocks in up in each of its layers, adding new layers at the top if needed
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::Link(node* block, node* const* up)
+{
+    for (unsigned layer = 0; layer < block->height; ++layer)
+    {
+        if (layer == layers_.size())
+        {
+            layers_.push_back(block);
+            continue;
+        }
+
+        auto& link = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        block->next(layer) = link;
+        link = block;
+    }
+}
+
+/*
+ * Unlinks block from each of its layers, dropping any top layers left empty
+ */
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::Unlink(node* block, node* const* up)
+{
+    for (unsigned layer = 0; layer < block->height; ++layer)
+    {
+        auto& link = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        link = block->next(layer);
+    }
+
+    while (!layers_.empty() && !layers_.back()) layers_.pop_back();
+}
+
+/*
+ * Draws a height from the level generator (probability of each higher layer based on p), capped at
+ * floor(log_1/p(blocks)) + 1 layers as skip_list::MaxHeight() does, so fewer than 1/p blocks are expected in the top
+ * lane and each lane is crossed in about 1/p steps (floor(ln(blocks)) + 1 if p is 0 or 1)
+ */
+template <typename T, unsigned BlockSize>
+unsigned blocked_skip_list<T, BlockSize>::RandomHeight()
+{
+    if (blocks_ == 0) return 1;
+
+    // the small margin keeps exact powers of 1/p from rounding down
+    const auto p = static_cast<double>(generator_.P());
+    const auto base = p > 0 && p < 1 ? std::log(1 / p) : 1.0;
+    return generator_(std::min(static_cast<unsigned>(std::log(static_cast<double>(blocks_)) / base + 1e-9) + 1, max_height));
+}
+
+template <typename T, unsigned BlockSize>
+typename blocked_skip_list<T, BlockSize>::node* blocked_skip_list<T, BlockSize>::CreateBlock(const unsigned height)
+{
+    void* memory = ::operator new(node::Bytes(height));
+    return new (memory) node(height);
+}
+
+template <typename T, unsigned BlockSize>
+void blocked_skip_list<T, BlockSize>::DestroyBlock(node* block)
+{
+    block->~node();
+    ::operator delete(block);
+}
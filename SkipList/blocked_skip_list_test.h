@@ -0,0 +1,50 @@
+/*
+ * Blocked skip list wrapped to implement the sorted_list interface for performance comparison.
+ *
+ * Should work with any type T that defines <,>, ==, !=, and operator++().
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "blocked_skip_list.h"
+#include "sorted_list.h"
+
+
+/*
+ * Blocked skip list wrapped class to implement sorted_list interface for testing.
+ */
+template <typename T, unsigned BlockSize = blocked_skip_list_block_size<T>()>
+class blocked_skip_list_test : public blocked_skip_list<T, BlockSize>, public sorted_list<T>
+{
+	typedef blocked_skip_list<T, BlockSize> base;
+
+public:
+	// Constructor
+	blocked_skip_list_test(float p = 0.5) : base(p) {}
+
+	// Constructor, block levels are generated from seed
+	blocked_skip_list_test(float p, std::uint64_t seed) : base(p, seed) {}
+
+	// sorted_list interface begin
+	std::string GetName() const override { return "blocked skip list"; }
+	void Insert(T val) override { base::Insert(val); }
+	bool Remove(T val) override { return base::Remove(val); }
+	bool Contains(T val) override { return base::Contains(val); }
+	void Clear() override { base::Clear(); }
+	size_t Size() const override { return base::Size(); }
+	void Fill(T min, T max) override { Clear(); for (T i = min; !(max < i); ++i) Insert(i); }
+
+	std::vector<T> AsVector() const override
+	{
+		std::vector<T> v;
+		v.reserve(Size());
+		for (auto& i : *this) v.push_back(i);
+		return v;
+	}
+	// sorted_list interface end
+};
@@ -0,0 +1,459 @@
+/*
+ * Lock-free concurrent skip list, following the design of Fraser ("Practical lock-freedom", 2004) as presented by
+ * Herlihy and Shavit ("The Art of Multiprocessor Programming", LockFreeSkipList).
+ *
+ * Each element is a tower node whose forward links are atomic words with a mark bit in the lowest bit. A set mark means
+ * the tower is being removed from that layer, and marked links are never changed again. Insert() links a tower from the
+ * bottom layer up with compare-and-swap, Remove() marks it from the top layer down, and every search that comes across
+ * a marked tower unlinks it before moving on.
+ *
+ * Insert(), Remove(), and Contains() are linearizable, taking effect when the bottom link of the tower is swung in,
+ * marked, or read. Layers above the bottom are only shortcuts and may lag behind. Iteration is weakly consistent: it
+ * never fails or returns an element twice, and sees every element present for the whole traversal.
+ *
+ * Removed towers are freed through epoch based reclamation (see skip_list_epoch.h) once no thread can still be reading
+ * them. Each thread that has used a list keeps a small record in it until the list is destroyed.
+ *
+ * Works with any type T that defines < operator, or any strict weak ordering given as Compare. Elements are unique.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "skip_list.h"
+#include "skip_list_epoch.h"
+
+/*
+ * Tower node for use with concurrent_skip_list. Like skip_list_node, a single allocation holding val once followed by an
+ * inline array of height atomic forward links, each a node address with the removal mark in its lowest bit.
+ */
+template <typename T>
+struct alignas(std::atomic<std::uintptr_t>) concurrent_skip_list_node
+{
+    // constructs val in place from args
+    template <typename... Args>
+    explicit concurrent_skip_list_node(unsigned height, Args&&... args)
+        : val(std::forward<Args>(args)...), height(height), state(0)
+    {
+        for (unsigned i = 0; i < height; ++i) new (links() + i) std::atomic<std::uintptr_t>(0);
+    }
+
+    const T val;
+    const unsigned height;          // number of layers this node can be linked into
+    std::atomic<unsigned> state;    // done flags of the inserting and removing threads, the last one retires the node
+
+    // forward link of this node in layer
+    std::atomic<std::uintptr_t>& next(unsigned layer) { return links()[layer]; }
+    const std::atomic<std::uintptr_t>& next(unsigned layer) const { return links()[layer]; }
+
+    // number of bytes used by a node with height links
+    static constexpr size_t Bytes(unsigned height)
+    {
+        return sizeof(concurrent_skip_list_node) + height * sizeof(std::atomic<std::uintptr_t>);
+    }
+
+private:
+    // links are stored directly after the node in the same allocation
+    std::atomic<std::uintptr_t>* links() { return reinterpret_cast<std::atomic<std::uintptr_t>*>(this + 1); }
+    const std::atomic<std::uintptr_t>* links() const { return reinterpret_cast<const std::atomic<std::uintptr_t>*>(this + 1); }
+};
+
+
+/*
+ * Lock-free ordered set. Any number of threads can call Insert(), Remove(), Contains(), and iterate at the same time.
+ * Tower heights are drawn with p = 1/2 from a generator local to each thread. Allocator must be safe to use from
+ * several threads at once (std::allocator is, skip_list_pool_allocator is not).
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>>
+class concurrent_skip_list : private skip_list_compare<Compare>
+{
+public:
+    using value_type = T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    struct iterator;
+
+    // tallest tower, enough for about 2^32 elements
+    static constexpr unsigned max_layers = 32;
+
+    // Constructor
+    explicit concurrent_skip_list(const Compare& compare = Compare(), const Allocator& allocator = Allocator());
+
+    concurrent_skip_list(const concurrent_skip_list&) = delete;
+    concurrent_skip_list& operator=(const concurrent_skip_list&) = delete;
+
+    // Destructor, no other thread may be using the list
+    ~concurrent_skip_list();
+
+    // returns true if val is in the list
+    bool Contains(const T& val) const;
+
+    // inserts val if it is not in the list already, returns true if it was inserted
+    bool Insert(const T& val) { return Emplace(val); }
+    bool Insert(T&& val) { return Emplace(std::move(val)); }
+
+    // constructs an element in place from args and inserts it if it is not in the list already, returns true if it was
+    // inserted
+    template <typename... Args>
+    bool Emplace(Args&&... args);
+
+    // removes val, returns true if it was removed by this call
+    bool Remove(const T& val);
+
+    // returns the number of elements, only exact while no other thread is changing the list
+    size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    // returns the comparator ordering the elements
+    Compare key_comp() const { return this->comp(); }
+
+private:
+    typedef concurrent_skip_list_node<T> node;
+    typedef skip_list_node_storage<T> node_storage;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_storage> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    static_assert(alignof(node) <= alignof(node_storage), "node storage units must keep nodes aligned");
+
+    // bits of node::state
+    static constexpr unsigned linked = 1;    // the inserting thread has finished linking the tower
+    static constexpr unsigned removed = 2;   // the removing thread has finished unlinking the tower
+
+    std::atomic<std::uintptr_t> head_[max_layers];   // first link of each layer
+    std::atomic<unsigned> layers_;                   // number of layers in use, only grows
+    std::atomic<size_t> size_;
+    node_allocator allocator_;
+    mutable skip_list_epoch epoch_;                  // destroyed before allocator_, it frees through it
+
+    // link from pred in layer, the head of the layer if pred is null
+    std::atomic<std::uintptr_t>& Link(node* pred, unsigned layer) { return pred ? pred->next(layer) : head_[layer]; }
+    const std::atomic<std::uintptr_t>& Link(const node* pred, unsigned layer) const { return pred ? pred->next(layer) : head_[layer]; }
+
+    // marked link encoding
+    static node* Ptr(std::uintptr_t link) { return reinterpret_cast<node*>(link & ~std::uintptr_t(1)); }
+    static std::uintptr_t Bits(const node* n) { return reinterpret_cast<std::uintptr_t>(n); }
+    static bool Marked(std::uintptr_t link) { return link & 1; }
+
+    // fills preds and succs with the last node before val and the first node not before it in each layer in use,
+    // unlinking every marked tower on the way. Returns true if succs[0] is equal to val
+    bool FindPath(const T& val, node** preds, node** succs);
+
+    // links a tower already in the bottom layer into its higher layers, giving up once it is marked for removal
+    void LinkTower(node* n, node** preds, node** succs);
+
+    // sets flag in the state of n, and retires n if the other thread involved in its life is done with it too
+    void Release(node* n, unsigned flag);
+
+    // returns a random tower height from a generator local to the calling thread
+    static unsigned RandomHeight();
+
+    template <typename... Args>
+    node* CreateNode(unsigned height, Args&&... args);
+    void DestroyNode(node* n);
+    static size_t NodeUnits(unsigned height) { return (node::Bytes(height) + sizeof(node_storage) - 1) / sizeof(node_storage); }
+
+    // reclaim function for epoch_, context is the list
+    static void Reclaim(void* context, void* object) { static_cast<concurrent_skip_list*>(context)->DestroyNode(static_cast<node*>(object)); }
+
+    bool Less(const T& a, const T& b) const { return this->comp()(a, b); }
+
+public:
+    /*
+     * Forward read only iterator. Keeps the creating thread pinned while it exists, so elements it reaches stay valid
+     * even if they are removed, and must not be passed to another thread. Removed elements are skipped.
+     */
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator() : node_(nullptr) {}
+
+        const T& operator*() const { return node_->val; }
+        const T* operator->() const { return &node_->val; }
+
+        // Prefix increment
+        iterator& operator++() { node_ = Skip(Ptr(node_->next(0).load(std::memory_order_acquire))); return *this; }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.node_ == b.node_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return a.node_ != b.node_; }
+
+    private:
+        friend class concurrent_skip_list;
+
+        iterator(const node* n, skip_list_epoch::guard guard) : node_(Skip(n)), guard_(std::move(guard)) {}
+
+        // returns the first node from n that is not marked for removal
+        static const node* Skip(const node* n)
+        {
+            while (n)
+            {
+                const auto link = n->next(0).load(std::memory_order_acquire);
+                if (!Marked(link)) break;
+                n = Ptr(link);
+            }
+            return n;
+        }
+
+        const node* node_;
+        skip_list_epoch::guard guard_;
+    };
+
+    iterator begin() const
+    {
+        auto guard = epoch_.Pin();
+        return iterator(Ptr(head_[0].load(std::memory_order_acquire)), std::move(guard));
+    }
+
+    iterator end() const { return iterator(); }
+};
+
+
+template <typename T, typename Compare, typename Allocator>
+concurrent_skip_list<T, Compare, Allocator>::concurrent_skip_list(const Compare& compare, const Allocator& allocator)
+    : skip_list_compare<Compare>(compare), layers_(1), size_(0), allocator_(allocator), epoch_(Reclaim, this)
+{
+    for (auto& link : head_) link.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * Frees every tower still in the list. Removed towers were unlinked from the bottom layer before being retired, so the
+ * epoch destructor frees those.
+ */
+template <typename T, typename Compare, typename Allocator>
+concurrent_skip_list<T, Compare, Allocator>::~concurrent_skip_list()
+{
+    auto current = Ptr(head_[0].load(std::memory_order_acquire));
+    while (current)
+    {
+        const auto next = Ptr(current->next(0).load(std::memory_order_relaxed));
+        DestroyNode(current);
+        current = next;
+    }
+}
+
+/*
+ * Wait-free search. Never writes, marked towers are stepped over rather than unlinked.
+ */
+template <typename T, typename Compare, typename Allocator>
+bool concurrent_skip_list<T, Compare, Allocator>::Contains(const T& val) const
+{
+    auto guard = epoch_.Pin();
+
+    const node* pred = nullptr;
+    const node* current = nullptr;
+    for (auto layer = layers_.load(std::memory_order_acquire); layer-- > 0;)
+    {
+        current = Ptr(Link(pred, layer).load(std::memory_order_acquire));
+        while (current)
+        {
+            const auto next = current->next(layer).load(std::memory_order_acquire);
+            if (Marked(next)) current = Ptr(next);
+            else if (Less(current->val, val)) { pred = current; current = Ptr(next); }
+            else break;
+        }
+    }
+
+    return current && !Less(val, current->val);
+}
+
+/*
+ * The element is in the list once the bottom layer link of the previous node is swung to its tower. The higher layers
+ * are linked afterwards.
+ */
+template <typename T, typename Compare, typename Allocator>
+template <typename... Args>
+bool concurrent_skip_list<T, Compare, Allocator>::Emplace(Args&&... args)
+{
+    const auto height = RandomHeight();
+    auto new_node = CreateNode(height, std::forward<Args>(args)...);
+
+    // searches must reach every layer the tower may be linked into
+    auto layers = layers_.load(std::memory_order_relaxed);
+    while (layers < height && !layers_.compare_exchange_weak(layers, height, std::memory_order_acq_rel)) {}
+
+    auto guard = epoch_.Pin();
+
+    node* preds[max_layers];
+    node* succs[max_layers];
+    while (true)
+    {
+        // nobody else has seen the node, so it can be freed right away
+        if (FindPath(new_node->val, preds, succs))
+        {
+            DestroyNode(new_node);
+            return false;
+        }
+
+        for (unsigned layer = 0; layer < height; ++layer) new_node->next(layer).store(Bits(succs[layer]), std::memory_order_relaxed);
+
+        auto expected = Bits(succs[0]);
+        if (Link(preds[0], 0).compare_exchange_strong(expected, Bits(new_node), std::memory_order_release, std::memory_order_relaxed))
+            break;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+
+    LinkTower(new_node, preds, succs);
+    Release(new_node, linked);
+    return true;
+}
+
+/*
+ * Marks every layer of the tower from the top down. The element is removed once its bottom link is marked, and only
+ * the thread that marks it reports the removal. A search then unlinks the tower from every layer.
+ */
+template <typename T, typename Compare, typename Allocator>
+bool concurrent_skip_list<T, Compare, Allocator>::Remove(const T& val)
+{
+    auto guard = epoch_.Pin();
+
+    node* preds[max_layers];
+    node* succs[max_layers];
+    if (!FindPath(val, preds, succs)) return false;
+
+    auto victim = succs[0];
+    for (auto layer = victim->height; layer-- > 1;)
+    {
+        auto next = victim->next(layer).load(std::memory_order_relaxed);
+        while (!Marked(next) && !victim->next(layer).compare_exchange_weak(next, next | 1, std::memory_order_acq_rel)) {}
+    }
+
+    auto next = victim->next(0).load(std::memory_order_relaxed);
+    while (!Marked(next))
+    {
+        if (victim->next(0).compare_exchange_weak(next, next | 1, std::memory_order_acq_rel))
+        {
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            FindPath(val, preds, succs);
+            Release(victim, removed);
+            return true;
+        }
+    }
+
+    // another thread removed it first
+    return false;
+}
+
+/*
+ * Search from the top layer in use. A marked tower is unlinked by swinging the link of its predecessor past it, which
+ * fails if the predecessor has been marked or changed in the meantime, and then the search starts over.
+ */
+template <typename T, typename Compare, typename Allocator>
+bool concurrent_skip_list<T, Compare, Allocator>::FindPath(const T& val, node** preds, node** succs)
+{
+retry:
+    node* pred = nullptr;
+    node* current = nullptr;
+    for (auto layer = layers_.load(std::memory_order_acquire); layer-- > 0;)
+    {
+        current = Ptr(Link(pred, layer).load(std::memory_order_acquire));
+        while (current)
+        {
+            auto next = current->next(layer).load(std::memory_order_acquire);
+            if (Marked(next))
+            {
+                auto expected = Bits(current);
+                if (!Link(pred, layer).compare_exchange_strong(expected, next & ~std::uintptr_t(1), std::memory_order_acq_rel,
+                                                               std::memory_order_relaxed))
+                    goto retry;
+                current = Ptr(next);
+            }
+            else if (Less(current->val, val)) { pred = current; current = Ptr(next); }
+            else break;
+        }
+
+        preds[layer] = pred;
+        succs[layer] = current;
+    }
+
+    return current && !Less(val, current->val);
+}
+
+/*
+ * Each layer is linked by first pointing the tower at its successor, which fails once the layer is marked, and then
+ * swinging the predecessor to the tower. If the path has changed the search is repeated. A tower removed while this
+ * was going on may have been linked into a layer after the remover unlinked it, so it is unlinked once more here.
+ */
+template <typename T, typename Compare, typename Allocator>
+void concurrent_skip_list<T, Compare, Allocator>::LinkTower(node* n, node** preds, node** succs)
+{
+    for (unsigned layer = 1; layer < n->height; ++layer)
+    {
+        while (true)
+        {
+            auto next = n->next(layer).load(std::memory_order_acquire);
+            if (Marked(next)) break;
+            if (Ptr(next) != succs[layer] &&
+                !n->next(layer).compare_exchange_strong(next, Bits(succs[layer]), std::memory_order_acq_rel))
+                break;
+
+            auto expected = Bits(succs[layer]);
+            if (Link(preds[layer], layer).compare_exchange_strong(expected, Bits(n), std::memory_order_release, std::memory_order_relaxed))
+                break;
+
+            // a new search only reaches n in the bottom layer if n hasn't been removed
+            if (!FindPath(n->val, preds, succs) || succs[0] != n) break;
+        }
+
+        if (Marked(n->next(layer).load(std::memory_order_acquire))) break;
+    }
+
+    if (Marked(n->next(0).load(std::memory_order_acquire))) FindPath(n->val, preds, succs);
+}
+
+/*
+ * A removed tower can only be freed once it is out of every layer. The remover unlinks it, but the inserter may still be
+ * linking it into higher layers, so whichever of the two finishes last retires it.
+ */
+template <typename T, typename Compare, typename Allocator>
+void concurrent_skip_list<T, Compare, Allocator>::Release(node* n, unsigned flag)
+{
+    if (n->state.fetch_or(flag, std::memory_order_acq_rel) == (linked | removed) - flag) epoch_.Retire(n);
+}
+
+template <typename T, typename Compare, typename Allocator>
+unsigned concurrent_skip_list<T, Compare, Allocator>::RandomHeight()
+{
+    thread_local skip_list_level_generator generator(0.5f);
+    return generator(max_layers);
+}
+
+/*
+ * Allocates storage for a tower node with room for height links from the allocator and constructs the node in it,
+ * forwarding args to the constructor of its value.
+ */
+template <typename T, typename Compare, typename Allocator>
+template <typename... Args>
+concurrent_skip_list_node<T>* concurrent_skip_list<T, Compare, Allocator>::CreateNode(unsigned height, Args&&... args)
+{
+    const auto units = NodeUnits(height);
+    auto memory = node_traits::allocate(allocator_, units);
+    try { return new (static_cast<void*>(memory)) node(height, std::forward<Args>(args)...); }
+    catch (...) { node_traits::deallocate(allocator_, memory, units); throw; }
+}
+
+/*
+ * Destroys a node created with CreateNode() and returns its storage to the allocator.
+ */
+template <typename T, typename Compare, typename Allocator>
+void concurrent_skip_list<T, Compare, Allocator>::DestroyNode(node* n)
+{
+    const auto units = NodeUnits(n->height);
+    n->~node();
+    node_traits::deallocate(allocator_, reinterpret_cast<node_storage*>(n), units);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copy-on-write handle to a skip_list.
+ *
+ * Copies of a cow_skip_list share one list until one of them is written to, at which point the writer clones the
+ * list (an O(n) structural copy, see skip_list's copy constructor) and keeps the clone to itself. Taking a snapshot of
+ * a large list to hand to a background job is then O(1), and the cost of the copy is only paid if the list changes
+ * while the snapshot is alive. A handle that is the only one left writes in place.
+ *
+ * A single handle must not be used from several threads at once, but handles sharing a list can each be used from
+ * their own thread since the shared list is only ever read. Finger search and auto-tuning write to the list on every
+ * read, so copying a handle turns them off on the list it shares. They can be turned back on through Mutable() on a
+ * handle that owns its list, until the handle is copied again.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "skip_list.h"
+
+
+/*
+ * Skip list handle with O(1) copies. Reads go to the shared list, writes first make sure this handle owns its list.
+ * Iterators stay valid until the next write through the handle they came from.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator, typename IndexPolicy = skip_list_unindexed,
+          typename LinkPolicy = skip_list_doubly_linked>
+class cow_skip_list
+{
+public:
+    using list_type = skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>;
+    using value_type = T;
+    using key_compare = Compare;
+    using iterator = typename list_type::iterator;
+
+    // Constructor, p is the probability that an element is promoted to the next higher layer
+    explicit cow_skip_list(float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+        : list_(std::make_shared<list_type>(p, compare, allocator)) {}
+
+    // Constructor, takes over the elements of list
+    explicit cow_skip_list(list_type&& list) : list_(std::make_shared<list_type>(std::move(list))) {}
+
+    // Copy constructor, shares the list of other, O(1)
+    cow_skip_list(const cow_skip_list& other) : list_(other.Share()) {}
+
+    // Move constructor
+    cow_skip_list(cow_skip_list&& other) noexcept = default;
+
+    // Assignment, shares the list of other, O(1)
+    cow_skip_list& operator=(const cow_skip_list& other)
+    {
+        list_ = other.Share();
+        return *this;
+    }
+
+    // Move assignment
+    cow_skip_list& operator=(cow_skip_list&& other) noexcept = default;
+
+    // returns a handle sharing the current contents, O(1)
+    cow_skip_list Snapshot() const { return *this; }
+
+    // returns true if another handle shares the list, so the next write will copy it
+    bool Shared() const { return list_.use_count() > 1; }
+
+    // read only access to the list
+    const list_type& Get() const { return *list_; }
+
+    // write access to the list, copying it first if it is shared. Valid until the handle is written to or copied
+    list_type& Mutable() { return Detach(); }
+
+    bool Contains(const T& val) const { return list_->Contains(val); }
+    iterator Find(const T& val) const { return list_->Find(val); }
+    iterator LowerBound(const T& val) const { return list_->LowerBound(val); }
+    iterator UpperBound(const T& val) const { return list_->UpperBound(val); }
+    size_t Size() const { return list_->Size(); }
+
+    void Insert(const T& val) { Detach().Insert(val); }
+    void Insert(T&& val) { Detach().Insert(std::move(val)); }
+
+    template <typename... Args>
+    void Emplace(Args&&... args) { Detach().Emplace(std::forward<Args>(args)...); }
+
+    bool Remove(const T& val) { return Detach().Remove(val); }
+    size_t EraseRange(const T& lo, const T& hi) { return Detach().EraseRange(lo, hi); }
+    void Clear() { Detach().Clear(); }
+
+    iterator begin() const { return list_->begin(); }
+
+    iterator end() const { return list_->end(); }
+
+private:
+    std::shared_ptr<list_type> list_;
+
+    // returns the list to share with a new handle, with the features that write on reads turned off. A list already
+    // shared has them off, so other handles reading it on other threads only ever see it read
+    const std::shared_ptr<list_type>& Share() const
+    {
+        if (list_->UsesFinger()) list_->UseFinger(false);
+        if constexpr (skip_list_tunable<LevelGenerator>::value)
+            if (list_->AutoTunes()) list_->AutoTune(false);
+        return list_;
+    }
+
+    // returns the list after giving this handle its own copy if it is shared
+    list_type& Detach()
+    {
+        if (list_.use_count() != 1) list_ = std::make_shared<list_type>(*list_);
+
+        // the last other handle may have just been released by another thread, make sure its reads are done
+        else std::atomic_thread_fence(std::memory_order_acquire);
+
+        return *list_;
+    }
+};
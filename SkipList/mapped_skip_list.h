@@ -0,0 +1,261 @@
+/*
+ * Read only skip list served straight from a file written by skip_list::Save().
+ *
+ * The file is memory mapped and searched in place: the records already hold the towers of the saved list, with links
+ * stored as offsets from the start of the file. Opening a list only maps the file and checks its header, so it takes
+ * the same time at any size, and pages are read in by the OS as searches first touch them, then shared through the
+ * page cache with every other process mapping the same file. Links are followed without bounds checks, Verify() checks
+ * the whole file against its checksum before trusting one that may have been damaged.
+ *
+ * Works with trivially copyable T, saved from a skip_list ordered by the same Compare.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "skip_list.h"
+#include "skip_list_file.h"
+
+
+/*
+ * Maps a skip list file for reading. Can be read from any number of threads at once, the file must not be changed
+ * while it is mapped.
+ */
+template <typename T, typename Compare = std::less<T>>
+class mapped_skip_list : private skip_list_compare<Compare>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "mapped_skip_list needs a trivially copyable T");
+
+    typedef skip_list_file::node<T> record;
+
+public:
+    using value_type = T;
+    using key_compare = Compare;
+
+    struct iterator;
+
+    // Constructor, maps the file at path. Throws std::runtime_error if it can't be opened or doesn't hold a list of T
+    explicit mapped_skip_list(const std::string& path, const Compare& compare = Compare());
+
+    mapped_skip_list(const mapped_skip_list&) = delete;
+    mapped_skip_list& operator=(const mapped_skip_list&) = delete;
+
+    // Move constructor
+    mapped_skip_list(mapped_skip_list&& other) noexcept
+        : skip_list_compare<Compare>(other), data_(std::exchange(other.data_, nullptr)), bytes_(std::exchange(other.bytes_, 0)),
+          header_(other.header_)
+#ifdef _WIN32
+        , mapping_(std::exchange(other.mapping_, nullptr))
+#endif
+    {}
+
+    // Destructor, unmaps the file
+    ~mapped_skip_list() { Unmap(); }
+
+    // returns true if list contains val
+    bool Contains(const T& val) const { return Find(val) != end(); }
+
+    // returns an iterator to an element equal to val, or end() if val is not in the list
+    iterator Find(const T& val) const
+    {
+        const auto node = LowerBoundNode(val);
+        return iterator(this, node && !Less(val, node->val) ? node : nullptr);
+    }
+
+    // returns an iterator to the first element not less than val, or end() if there is none
+    iterator LowerBound(const T& val) const { return iterator(this, LowerBoundNode(val)); }
+
+    // returns an iterator to the first element greater than val, or end() if there is none
+    iterator UpperBound(const T& val) const { return iterator(this, UpperBoundNode(val)); }
+
+    // returns the number of elements in the list
+    size_t Size() const { return static_cast<size_t>(header_.size); }
+
+    // returns the number of bytes mapped
+    size_t MappedBytes() const { return bytes_; }
+
+    // reads the whole file and returns true if it matches its checksum
+    bool Verify() const
+    {
+        return skip_list_file::Checksum(data_ + sizeof(skip_list_file::header), bytes_ - sizeof(skip_list_file::header)) ==
+            header_.body_checksum;
+    }
+
+    // returns the comparator ordering the list
+    Compare key_comp() const { return this->comp(); }
+
+    iterator begin() const { return iterator(this, Node(Head(0))); }
+
+    iterator end() const { return iterator(this, nullptr); }
+
+private:
+    const unsigned char* data_;
+    size_t bytes_;
+    skip_list_file::header header_;
+#ifdef _WIN32
+    HANDLE mapping_;
+#endif
+
+    void Unmap();
+
+    // record at offset, null for offset 0
+    const record* Node(std::uint64_t offset) const { return offset ? reinterpret_cast<const record*>(data_ + offset) : nullptr; }
+
+    // offset of the first record in layer
+    std::uint64_t Head(unsigned layer) const
+    {
+        if (layer >= header_.layers) return 0;
+        std::uint64_t offset;
+        std::memcpy(&offset, data_ + sizeof(skip_list_file::header) + layer * sizeof(offset), sizeof(offset));
+        return offset;
+    }
+
+    // offset of the link after pred in layer, pred null is the start of the layer
+    std::uint64_t Next(const record* pred, unsigned layer) const { return pred ? pred->next(layer) : Head(layer); }
+
+    // first record not less than val, or the first greater than val if Upper
+    template <bool Upper>
+    const record* Search(const T& val) const
+    {
+        const record* pred = nullptr;
+        const record* current = nullptr;
+        for (auto layer = header_.layers; layer-- > 0;)
+        {
+            current = Node(Next(pred, layer));
+            while (current && (Upper ? !Less(val, current->val) : Less(current->val, val)))
+            {
+                pred = current;
+                current = Node(current->next(layer));
+            }
+        }
+        return current;
+    }
+
+    const record* LowerBoundNode(const T& val) const { return Search<false>(val); }
+    const record* UpperBoundNode(const T& val) const { return Search<true>(val); }
+
+    bool Less(const T& a, const T& b) const { return this->comp()(a, b); }
+
+public:
+    /*
+     * Forward read only iterator over the mapped elements, valid while the list is.
+     */
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator() : list_(nullptr), node_(nullptr) {}
+
+        const T& operator*() const { return node_->val; }
+        const T* operator->() const { return &node_->val; }
+
+        // Prefix increment
+        iterator& operator++() { node_ = list_->Node(node_->next(0)); return *this; }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.node_ == b.node_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return a.node_ != b.node_; }
+
+    private:
+        friend class mapped_skip_list;
+
+        iterator(const mapped_skip_list* list, const record* node) : list_(list), node_(node) {}
+
+        const mapped_skip_list* list_;
+        const record* node_;
+    };
+};
+
+
+/*
+ * Maps the file and checks its header, nothing past the header is read here.
+ */
+template <typename T, typename Compare>
+mapped_skip_list<T, Compare>::mapped_skip_list(const std::string& path, const Compare& compare)
+    : skip_list_compare<Compare>(compare), data_(nullptr), bytes_(0), header_()
+#ifdef _WIN32
+    , mapping_(nullptr)
+#endif
+{
+    const auto fail = [&](const char* why) { throw std::runtime_error("mapped_skip_list couldn't " + std::string(why) + " " + path); };
+
+#ifdef _WIN32
+    const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) fail("open");
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(skip_list_file::header)))
+    {
+        CloseHandle(file);
+        fail("use");
+    }
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping_) fail("map");
+    data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+        CloseHandle(mapping_);
+        fail("map");
+    }
+    bytes_ = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) fail("open");
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(skip_list_file::header)))
+    {
+        close(file);
+        fail("use");
+    }
+    const auto data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (data == MAP_FAILED) fail("map");
+    data_ = static_cast<const unsigned char*>(data);
+    bytes_ = static_cast<size_t>(status.st_size);
+#endif
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    try { skip_list_file::CheckHeader<T>(header_, bytes_, path); }
+    catch (...) { Unmap(); throw; }
+}
+
+template <typename T, typename Compare>
+void mapped_skip_list<T, Compare>::Unmap()
+{
+    if (!data_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+#else
+    munmap(const_cast<unsigned char*>(data_), bytes_);
+#endif
+    data_ = nullptr;
+}
@@ -0,0 +1,394 @@
+/*
+ * Skip list split by key range into shards, each an independent skip_list behind its own lock.
+ *
+ * Shard i holds the elements not less than boundary i - 1 and less than boundary i, so threads working on different
+ * key ranges never touch the same lock or the same nodes. Lookups take a shared lock on their shard, Insert() and
+ * Remove() an exclusive one. Batches given to Apply() are routed to their shards and applied to all shards in parallel
+ * on a thread pool, holding each shard lock once per batch instead of once per operation.
+ *
+ * Boundaries start out unset (everything goes to the first shard) and are recomputed whenever a shard grows to more
+ * than twice its share of the elements. Rebalancing rebuilds every shard in O(n) with skip_list::AssignSorted(), and
+ * waits for at least n / shards insertions since the last one, so it costs O(shards) per insertion amortized. A run of
+ * equal elements never splits across shards and can leave its shard overfull however the boundaries are placed, the
+ * wait keeps such a shard from being rebuilt on every insertion.
+ *
+ * Works with any copyable type T that defines < operator, or any strict weak ordering given as Compare.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "skip_list.h"
+#include "skip_list_thread_pool.h"
+
+
+/* one operation of a batch for sharded_skip_list::Apply() */
+template <typename T>
+struct sharded_skip_list_op
+{
+    enum type { insert, remove };
+
+    type op;
+    T val;
+};
+
+
+/*
+ * Ordered multiset split into shard_count skip lists by key range. Every method except iteration can be called from any
+ * number of threads at once. Compare, Allocator, and LevelGenerator are passed on to the skip list of each shard. Each
+ * shard gets its own copy of the allocator from select_on_container_copy_construction(), so a skip_list_pool_allocator
+ * gives every shard its own pool. Allocators whose copies share state must be safe to use from several threads at once.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator>
+class sharded_skip_list
+{
+    typedef skip_list<T, Compare, Allocator, LevelGenerator> list_type;
+
+public:
+    using value_type = T;
+    using key_compare = Compare;
+    using op_type = sharded_skip_list_op<T>;
+
+    struct iterator;
+
+    // shards aren't rebalanced while the list has fewer elements than this per shard
+    static constexpr size_t min_shard_size = 1024;
+
+    // Constructor. threads is the size of the pool applying batches, p is passed on to the skip list of each shard
+    explicit sharded_skip_list(unsigned shard_count = std::max(1u, std::thread::hardware_concurrency()),
+                               unsigned threads = std::max(1u, std::thread::hardware_concurrency()) - 1,
+                               float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator());
+
+    // returns true if val is in the list
+    bool Contains(const T& val) const
+    {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+        auto& s = ShardOf(val);
+        std::shared_lock<std::shared_mutex> lock(s.mutex);
+        return s.list.Contains(val);
+    }
+
+    // inserts val
+    void Insert(const T& val);
+
+    // removes one element equal to val, returns true if one was removed
+    bool Remove(const T& val);
+
+    // applies the operations of batch, in order for each key, and returns the number that changed the list (every
+    // insert and each remove that found its element). The shards are updated in parallel
+    size_t Apply(const std::vector<op_type>& batch);
+
+    // removes all elements, keeping the shard boundaries
+    void Clear();
+
+    // returns the number of elements
+    size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    // returns the number of shards
+    size_t Shards() const { return shards_.size(); }
+
+    // returns the number of elements in shard i
+    size_t ShardSize(size_t i) const
+    {
+        std::shared_lock<std::shared_mutex> lock(shards_[i]->mutex);
+        return shards_[i]->list.Size();
+    }
+
+    // recomputes the shard boundaries so every shard holds about the same number of elements, and rebuilds the shards
+    void Rebalance();
+
+    // returns the number of times the shards have been rebuilt by Rebalance() or after an insertion
+    size_t Rebalances() const { return rebalances_.load(std::memory_order_relaxed); }
+
+    // returns the comparator ordering the elements
+    Compare key_comp() const { return compare_; }
+
+private:
+    struct shard
+    {
+        shard(float p, const Compare& compare, const Allocator& allocator) : list(p, compare, allocator) {}
+
+        mutable std::shared_mutex mutex;
+        list_type list;
+    };
+
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::vector<T> boundaries_;                  // first key of shards 1, 2, ... once the list has been rebalanced
+    mutable std::shared_mutex layout_;           // held shared by every operation, exclusive to change boundaries_
+    std::atomic<size_t> size_;
+    std::atomic<size_t> inserted_;               // insertions since the last rebalance
+    std::atomic<size_t> rebalances_;
+    Compare compare_;
+    std::unique_ptr<skip_list_thread_pool> pool_;
+
+    // index of the shard holding val
+    size_t ShardIndex(const T& val) const
+    {
+        return static_cast<size_t>(std::upper_bound(boundaries_.begin(), boundaries_.end(), val, compare_) - boundaries_.begin());
+    }
+
+    shard& ShardOf(const T& val) const { return *shards_[ShardIndex(val)]; }
+
+    // true if a shard of size holds more than twice its share of the elements, and enough elements have been inserted
+    // since the last rebalance to pay for another
+    bool Overfull(size_t size) const
+    {
+        return shards_.size() > 1 && size > min_shard_size && size > 2 * Size() / shards_.size() &&
+               inserted_.load(std::memory_order_relaxed) >= Size() / shards_.size();
+    }
+
+    // rebalances if some shard is still overfull once no other thread is using the list
+    void RebalanceIfOverfull();
+
+    // rebalances, layout_ must be held exclusively
+    void Repartition();
+
+public:
+    /*
+     * Forward read only iterator over all shards in order. Not safe while other threads change the list.
+     */
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        const T& operator*() const { return *it_; }
+        const T* operator->() const { return &*it_; }
+
+        // Prefix increment
+        iterator& operator++()
+        {
+            ++it_;
+            SkipEmpty();
+            return *this;
+        }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.shard_ == b.shard_ && a.it_ == b.it_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return !(a == b); }
+
+    private:
+        friend class sharded_skip_list;
+
+        iterator(const sharded_skip_list* owner, size_t shard)
+            : owner_(owner), shard_(shard), it_(shard < owner->shards_.size() ? owner->shards_[shard]->list.begin() : typename list_type::iterator())
+        {
+            SkipEmpty();
+        }
+
+        // moves on to the first element of the next non-empty shard once the current shard is done
+        void SkipEmpty()
+        {
+            while (shard_ < owner_->shards_.size() && it_ == owner_->shards_[shard_]->list.end())
+                if (++shard_ < owner_->shards_.size()) it_ = owner_->shards_[shard_]->list.begin();
+        }
+
+        const sharded_skip_list* owner_;
+        size_t shard_;
+        typename list_type::iterator it_;
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+
+    iterator end() const { return iterator(this, shards_.size()); }
+};
+
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+sharded_skip_list<T, Compare, Allocator, LevelGenerator>::sharded_skip_list(unsigned shard_count, const unsigned threads,
+                                                                           const float p, const Compare& compare,
+                                                                           const Allocator& allocator)
+    : size_(0), inserted_(0), rebalances_(0), compare_(compare), pool_(std::make_unique<skip_list_thread_pool>(threads))
+{
+    shard_count = std::max(1u, shard_count);
+    shards_.reserve(shard_count);
+    for (unsigned i = 0; i < shard_count; ++i)
+        shards_.push_back(std::make_unique<shard>(p, compare, std::allocator_traits<Allocator>::select_on_container_copy_construction(allocator)));
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Insert(const T& val)
+{
+    bool overfull;
+    {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+        auto& s = ShardOf(val);
+        std::unique_lock<std::shared_mutex> lock(s.mutex);
+        s.list.Insert(val);
+        size_.fetch_add(1, std::memory_order_relaxed);
+        inserted_.fetch_add(1, std::memory_order_relaxed);
+        overfull = Overfull(s.list.Size());
+    }
+    if (overfull) RebalanceIfOverfull();
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+bool sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Remove(const T& val)
+{
+    std::shared_lock<std::shared_mutex> layout(layout_);
+    auto& s = ShardOf(val);
+    std::unique_lock<std::shared_mutex> lock(s.mutex);
+    if (!s.list.Remove(val)) return false;
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+/*
+ * Operations are bucketed by shard keeping their order, so operations on the same key (always in the same shard) are
+ * applied in batch order. Each shard is then one task on the pool.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+size_t sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Apply(const std::vector<op_type>& batch)
+{
+    size_t changed = 0;
+    bool overfull = false;
+    {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+
+        std::vector<std::vector<const op_type*>> buckets(shards_.size());
+        for (const auto& op : batch) buckets[ShardIndex(op.val)].push_back(&op);
+
+        std::atomic<size_t> inserted(0);
+        std::atomic<size_t> removed(0);
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            if (buckets[i].empty()) continue;
+            tasks.emplace_back([&, i]
+            {
+                auto& s = *shards_[i];
+                size_t shard_inserted = 0;
+                size_t shard_removed = 0;
+                {
+                    std::unique_lock<std::shared_mutex> lock(s.mutex);
+                    for (const auto op : buckets[i])
+                    {
+                        if (op->op == op_type::insert)
+                        {
+                            s.list.Insert(op->val);
+                            ++shard_inserted;
+                        }
+                        else if (s.list.Remove(op->val)) ++shard_removed;
+                    }
+                }
+                inserted += shard_inserted;
+                removed += shard_removed;
+            });
+        }
+
+        // count whatever was applied even if a task threw
+        try { pool_->Run(tasks); }
+        catch (...)
+        {
+            size_ += inserted - removed;
+            inserted_ += inserted;
+            throw;
+        }
+        size_ += inserted - removed;
+        inserted_ += inserted;
+        changed = inserted + removed;
+
+        for (size_t i = 0; i < shards_.size() && !overfull; ++i)
+            if (!buckets[i].empty()) overfull = Overfull(ShardSize(i));
+    }
+    if (overfull) RebalanceIfOverfull();
+    return changed;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Clear()
+{
+    std::shared_lock<std::shared_mutex> layout(layout_);
+    for (auto& s : shards_)
+    {
+        std::unique_lock<std::shared_mutex> lock(s->mutex);
+        size_.fetch_sub(s->list.Size(), std::memory_order_relaxed);
+        s->list.Clear();
+    }
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Rebalance()
+{
+    std::unique_lock<std::shared_mutex> layout(layout_);
+    Repartition();
+}
+
+/*
+ * Another thread may have rebalanced between the check and taking the lock, so the check is repeated.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void sharded_skip_list<T, Compare, Allocator, LevelGenerator>::RebalanceIfOverfull()
+{
+    std::unique_lock<std::shared_mutex> layout(layout_);
+    for (const auto& s : shards_)
+    {
+        if (Overfull(s->list.Size()))
+        {
+            Repartition();
+            return;
+        }
+    }
+}
+
+/*
+ * Gathers every element in order, takes the boundaries at equal steps through them, and rebuilds each shard from its
+ * slice. Equal elements always land in the same shard since the boundary is the first key of a shard.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void sharded_skip_list<T, Compare, Allocator, LevelGenerator>::Repartition()
+{
+    std::vector<T> elements;
+    elements.reserve(Size());
+    for (const auto& s : shards_) elements.insert(elements.end(), s->list.begin(), s->list.end());
+    inserted_.store(0, std::memory_order_relaxed);
+    if (elements.empty()) return;
+    rebalances_.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<T> boundaries;
+    boundaries.reserve(shards_.size() - 1);
+    for (size_t i = 1; i < shards_.size(); ++i) boundaries.push_back(elements[i * elements.size() / shards_.size()]);
+    boundaries_.swap(boundaries);
+
+    // if a shard fails to build, the elements not yet moved into a shard are lost, recount to stay consistent
+    auto recount = [this]
+    {
+        size_t size = 0;
+        for (const auto& s : shards_) size += s->list.Size();
+        size_.store(size, std::memory_order_relaxed);
+    };
+
+    auto first = elements.begin();
+    try
+    {
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            const auto last = i + 1 < shards_.size() ? std::lower_bound(first, elements.end(), boundaries_[i], compare_) : elements.end();
+            shards_[i]->list.AssignSorted(std::make_move_iterator(first), std::make_move_iterator(last));
+            first = last;
+        }
+    }
+    catch (...)
+    {
+        recount();
+        throw;
+    }
+}
@@ -0,0 +1,328 @@
+/*
+ * Skip list for one writer thread and any number of reader threads.
+ *
+ * Only one thread may call Insert(), Remove(), and Clear() at a time (the writer), while any number of other threads
+ * call Contains(), Find(), and iterate (the readers). Readers take no locks and perform no atomic read-modify-write:
+ * a search is plain acquire loads of the forward links, so it is wait-free and readers never write to shared cache
+ * lines. The writer publishes a new tower by fully setting up its links and then swinging each layer to it with a
+ * release store, bottom layer first, and removes a tower by storing its successors over it from the top layer down.
+ * A removed tower keeps its forward links, so readers standing on it carry on past it.
+ *
+ * Removed towers are freed through epoch based reclamation (see skip_list_epoch.h). Pinning costs a reader one store
+ * and one load on a cache line only its own thread writes.
+ *
+ * Works with any type T that defines < operator, or any strict weak ordering given as Compare.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "concurrent_skip_list.h"
+#include "skip_list_epoch.h"
+#include "skip_list_level.h"
+
+
+/*
+ * Skip list with a single writer and wait-free readers. Towers are concurrent_skip_list_node (the mark bit and state are
+ * unused). p is the probability that an inserted element is promoted to the next higher layer.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator>
+class single_writer_skip_list : private skip_list_compare<Compare>
+{
+public:
+    using value_type = T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    struct iterator;
+
+    // tallest tower, enough for about 2^32 elements at p = 1/2
+    static constexpr unsigned max_layers = 32;
+
+    // Constructor
+    explicit single_writer_skip_list(float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+        : single_writer_skip_list(p, skip_list_random::RandomSeed(), compare, allocator) {}
+
+    // Constructor, levels are generated from seed
+    single_writer_skip_list(float p, std::uint64_t seed, const Compare& compare = Compare(), const Allocator& allocator = Allocator());
+
+    single_writer_skip_list(const single_writer_skip_list&) = delete;
+    single_writer_skip_list& operator=(const single_writer_skip_list&) = delete;
+
+    // Destructor, no other thread may be using the list
+    ~single_writer_skip_list();
+
+    // reader: returns true if val is in the list
+    bool Contains(const T& val) const
+    {
+        auto guard = epoch_.Pin();
+        auto node = LowerBoundNode(val);
+        return node && !Less(val, node->val);
+    }
+
+    // reader: returns an iterator to an element equal to val, or end() if val is not in the list
+    iterator Find(const T& val) const
+    {
+        auto guard = epoch_.Pin();
+        auto node = LowerBoundNode(val);
+        return node && !Less(val, node->val) ? iterator(node, std::move(guard)) : end();
+    }
+
+    // writer: inserts val
+    void Insert(const T& val) { Emplace(val); }
+    void Insert(T&& val) { Emplace(std::move(val)); }
+
+    // writer: constructs an element in place from args and inserts it
+    template <typename... Args>
+    void Emplace(Args&&... args);
+
+    // writer: removes one element equal to val, returns true if one was removed
+    bool Remove(const T& val);
+
+    // writer: removes all elements
+    void Clear();
+
+    // returns the number of elements, only exact on the writer thread
+    size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    // returns the promotion probability
+    float P() const { return generator_.P(); }
+
+    // returns the comparator ordering the elements
+    Compare key_comp() const { return this->comp(); }
+
+private:
+    typedef concurrent_skip_list_node<T> node;
+    typedef skip_list_node_storage<T> node_storage;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_storage> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    static_assert(alignof(node) <= alignof(node_storage), "node storage units must keep nodes aligned");
+
+    std::atomic<std::uintptr_t> head_[max_layers];   // first link of each layer
+    std::atomic<unsigned> layers_;                   // number of layers in use, only grows
+    std::atomic<size_t> size_;
+    LevelGenerator generator_;                       // only used by the writer
+    node_allocator allocator_;
+    mutable skip_list_epoch epoch_;                  // destroyed before allocator_, it frees through it
+
+    // link from pred in layer, the head of the layer if pred is null
+    std::atomic<std::uintptr_t>& Link(node* pred, unsigned layer) { return pred ? pred->next(layer) : head_[layer]; }
+    const std::atomic<std::uintptr_t>& Link(const node* pred, unsigned layer) const { return pred ? pred->next(layer) : head_[layer]; }
+
+    static node* Ptr(std::uintptr_t link) { return reinterpret_cast<node*>(link); }
+    static std::uintptr_t Bits(const node* n) { return reinterpret_cast<std::uintptr_t>(n); }
+
+    // returns the first node not less than val, the caller must be pinned
+    const node* LowerBoundNode(const T& val) const;
+
+    // writer: fills up with the last node before val in each layer in use
+    void FindPath(const T& val, node** up);
+
+    template <typename... Args>
+    node* CreateNode(unsigned height, Args&&... args);
+    void DestroyNode(node* n);
+    static size_t NodeUnits(unsigned height) { return (node::Bytes(height) + sizeof(node_storage) - 1) / sizeof(node_storage); }
+
+    // reclaim function for epoch_, context is the list
+    static void Reclaim(void* context, void* object) { static_cast<single_writer_skip_list*>(context)->DestroyNode(static_cast<node*>(object)); }
+
+    bool Less(const T& a, const T& b) const { return this->comp()(a, b); }
+
+public:
+    /*
+     * Forward read only iterator. Keeps the creating thread pinned while it exists, so elements it reaches stay valid
+     * even if they are removed, and must not be passed to another thread.
+     */
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator() : node_(nullptr) {}
+
+        const T& operator*() const { return node_->val; }
+        const T* operator->() const { return &node_->val; }
+
+        // Prefix increment
+        iterator& operator++() { node_ = Ptr(node_->next(0).load(std::memory_order_acquire)); return *this; }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.node_ == b.node_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return a.node_ != b.node_; }
+
+    private:
+        friend class single_writer_skip_list;
+
+        iterator(const node* n, skip_list_epoch::guard guard) : node_(n), guard_(std::move(guard)) {}
+
+        const node* node_;
+        skip_list_epoch::guard guard_;
+    };
+
+    iterator begin() const
+    {
+        auto guard = epoch_.Pin();
+        return iterator(Ptr(head_[0].load(std::memory_order_acquire)), std::move(guard));
+    }
+
+    iterator end() const { return iterator(); }
+};
+
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::single_writer_skip_list(const float p, const std::uint64_t seed,
+                                                                                       const Compare& compare, const Allocator& allocator)
+    : skip_list_compare<Compare>(compare), layers_(1), size_(0), generator_(p, seed), allocator_(allocator), epoch_(Reclaim, this)
+{
+    for (auto& link : head_) link.store(0, std::memory_order_relaxed);
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::~single_writer_skip_list()
+{
+    auto current = Ptr(head_[0].load(std::memory_order_relaxed));
+    while (current)
+    {
+        const auto next = Ptr(current->next(0).load(std::memory_order_relaxed));
+        DestroyNode(current);
+        current = next;
+    }
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+const concurrent_skip_list_node<T>* single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::LowerBoundNode(const T& val) const
+{
+    const node* pred = nullptr;
+    const node* current = nullptr;
+    for (auto layer = layers_.load(std::memory_order_acquire); layer-- > 0;)
+    {
+        current = Ptr(Link(pred, layer).load(std::memory_order_acquire));
+        while (current && Less(current->val, val))
+        {
+            pred = current;
+            current = Ptr(current->next(layer).load(std::memory_order_acquire));
+        }
+    }
+    return current;
+}
+
+/*
+ * Only the writer changes links, so its own loads need no ordering.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::FindPath(const T& val, node** up)
+{
+    node* pred = nullptr;
+    for (auto layer = layers_.load(std::memory_order_relaxed); layer-- > 0;)
+    {
+        for (auto next = Ptr(Link(pred, layer).load(std::memory_order_relaxed)); next && Less(next->val, val);
+             next = Ptr(next->next(layer).load(std::memory_order_relaxed)))
+            pred = next;
+        up[layer] = pred;
+    }
+}
+
+/*
+ * The new tower is complete before it is reachable. Each layer is published with a release store, bottom layer first,
+ * so a reader that finds the tower in any layer also sees its value and links.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+template <typename... Args>
+void single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::Emplace(Args&&... args)
+{
+    const auto height = generator_(max_layers);
+    auto new_node = CreateNode(height, std::forward<Args>(args)...);
+
+    if (layers_.load(std::memory_order_relaxed) < height) layers_.store(height, std::memory_order_release);
+
+    node* up[max_layers];
+    FindPath(new_node->val, up);
+
+    for (unsigned layer = 0; layer < height; ++layer)
+        new_node->next(layer).store(Link(up[layer], layer).load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (unsigned layer = 0; layer < height; ++layer)
+        Link(up[layer], layer).store(Bits(new_node), std::memory_order_release);
+
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Unlinks the tower from the top layer down, then retires it. Readers that already reached it still see its links.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+bool single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::Remove(const T& val)
+{
+    auto guard = epoch_.Pin();
+
+    node* up[max_layers];
+    FindPath(val, up);
+
+    auto victim = Ptr(Link(up[0], 0).load(std::memory_order_relaxed));
+    if (!victim || Less(val, victim->val)) return false;
+
+    // the first tower not less than val in the bottom layer is also the first in each of its layers
+    for (auto layer = victim->height; layer-- > 0;)
+        Link(up[layer], layer).store(victim->next(layer).load(std::memory_order_relaxed), std::memory_order_release);
+
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    epoch_.Retire(victim);
+    return true;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::Clear()
+{
+    auto guard = epoch_.Pin();
+
+    auto current = Ptr(head_[0].load(std::memory_order_relaxed));
+    for (auto& link : head_) link.store(0, std::memory_order_release);
+
+    while (current)
+    {
+        const auto next = Ptr(current->next(0).load(std::memory_order_relaxed));
+        epoch_.Retire(current);
+        current = next;
+    }
+    size_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * Allocates storage for a tower node with room for height links from the allocator and constructs the node in it,
+ * forwarding args to the constructor of its value.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+template <typename... Args>
+concurrent_skip_list_node<T>* single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::CreateNode(unsigned height, Args&&... args)
+{
+    const auto units = NodeUnits(height);
+    auto memory = node_traits::allocate(allocator_, units);
+    try { return new (static_cast<void*>(memory)) node(height, std::forward<Args>(args)...); }
+    catch (...) { node_traits::deallocate(allocator_, memory, units); throw; }
+}
+
+/*
+ * Destroys a node created with CreateNode() and returns its storage to the allocator.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void single_writer_skip_list<T, Compare, Allocator, LevelGenerator>::DestroyNode(node* n)
+{
+    const auto units = NodeUnits(n->height);
+    n->~node();
+    node_traits::deallocate(allocator_, reinterpret_cast<node_storage*>(n), units);
+}
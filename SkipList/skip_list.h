@@ -5,51 +5,223 @@
  * A skip list is an ordered sequence data structure with O(logn) running time for Insert(), Remove(), and Contains().
  * Advantages are fast searching like an ordered array, combined with fast insertion/deletion like a linked list.
  *
- * Works with any type T that defines < operator.
+ * Works with any type T that defines < operator, or any strict weak ordering given as Compare.
  * 
  * Author: Mike Greber
  */
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <cassert>
 #include <ostream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "skip_list_file.h"
+#include "skip_list_level.h"
+
+/*
+ * Tower node for use with skip_list. A node is a single allocation holding val once, followed by an inline array of
+ * height forward links (one for each layer the node is part of). Nodes of doubly linked lists (Linked) also link back to
+ * the previous node in the bottom layer.
+ */
+template <typename T, bool Linked = true>
+struct skip_list_node;
+
+/* link to the previous node in the bottom layer, empty (and taking no space) in singly linked lists */
+template <typename T, bool Linked>
+struct skip_list_node_prev
+{
+    skip_list_node<T, Linked>* prev = nullptr;
+};
 
-/* node for use with skip_list */
 template <typename T>
-struct skip_list_node
+struct skip_list_node_prev<T, false> {};
+
+template <typename T, bool Linked>
+struct alignas(void*) skip_list_node : skip_list_node_prev<T, Linked>
 {
-    skip_list_node() : val(0), next(nullptr), prev(nullptr), down(nullptr){}
-    
-    skip_list_node(T val, skip_list_node* next = nullptr, skip_list_node* prev = nullptr, skip_list_node* down = nullptr)
-        : val(val), next(next), prev(prev), down(down) {}
-    
+    // constructs val in place from args
+    template <typename... Args>
+    explicit skip_list_node(unsigned height, Args&&... args) : val(std::forward<Args>(args)...), height(height)
+    {
+        for (unsigned i = 0; i < height; ++i) next(i) = nullptr;
+    }
+
     const T val;
-    skip_list_node* next;
-    skip_list_node* prev;
-    skip_list_node* down;
+    unsigned height;        // number of layers this node is linked into
+
+    // forward link of this node in layer
+    skip_list_node*& next(unsigned layer) { return links()[layer]; }
+    skip_list_node* next(unsigned layer) const { return links()[layer]; }
+
+    // number of bottom layer steps the forward link in layer skips, only stored in nodes of indexed lists
+    size_t& width(unsigned layer) { return reinterpret_cast<size_t*>(links() + height)[layer]; }
+    size_t width(unsigned layer) const { return reinterpret_cast<const size_t*>(links() + height)[layer]; }
+
+    // number of bytes used by a node with height links, plus a width for each link if indexed
+    static constexpr size_t Bytes(unsigned height, bool indexed = false)
+    {
+        return sizeof(skip_list_node) + height * (sizeof(skip_list_node*) + (indexed ? sizeof(size_t) : 0));
+    }
+
+private:
+    // links are stored directly after the node in the same allocation
+    skip_list_node** links() { return reinterpret_cast<skip_list_node**>(this + 1); }
+    skip_list_node* const* links() const { return reinterpret_cast<skip_list_node* const*>(this + 1); }
+};
+
+/* allocation unit for skip_list_node, nodes are allocated as an array of units large enough for the node and its links */
+template <typename T>
+struct alignas(skip_list_node<T>) skip_list_node_storage
+{
+    unsigned char bytes[alignof(skip_list_node<T>)];
+};
+
+/* true if allocator A can free every block it has handed out at once through Release(), and count them with BlocksInUse() */
+template <typename A, typename = void>
+struct skip_list_releasable : std::false_type {};
+
+template <typename A>
+struct skip_list_releasable<A, std::void_t<decltype(std::declval<A&>().Release()), decltype(std::declval<const A&>().BlocksInUse())>>
+    : std::true_type {};
+
+/* true if level generator G can change its promotion probability through SetP() */
+template <typename G, typename = void>
+struct skip_list_tunable : std::false_type {};
+
+template <typename G>
+struct skip_list_tunable<G, std::void_t<decltype(std::declval<G&>().SetP(0.5f))>> : std::true_type {};
+
+/*
+ * Index policies for skip_list. skip_list_indexed stores the width (number of elements skipped) of every link, which
+ * enables the positional operations Rank(), At(), Select(), EraseAt(), and CountRange() in O(logn) at the cost of one
+ * extra word per link. skip_list_unindexed (the default) stores nothing extra.
+ */
+struct skip_list_unindexed { static constexpr bool indexed = false; };
+struct skip_list_indexed { static constexpr bool indexed = true; };
+
+/*
+ * Link policies for skip_list. skip_list_doubly_linked (the default) keeps a link to the previous node in every tower,
+ * so iterators step back in O(1). skip_list_singly_linked drops it, saving a pointer per element, and iterators step
+ * back by searching for the previous element in O(logn). Removal never needs it, the search path gives the nodes before.
+ */
+struct skip_list_doubly_linked { static constexpr bool linked = true; };
+struct skip_list_singly_linked { static constexpr bool linked = false; };
+
+/*
+ * Shape and memory of a skip_list at one point, see skip_list::Stats(). Heights follow a geometric distribution, so
+ * promotion_ratio should be close to p, and each layer about 1/p times as sparse as the one below it.
+ */
+struct skip_list_stats
+{
+    size_t size = 0;                    // number of elements
+    double p = 0;                       // configured probability that a tower is promoted to the next layer
+    double promotion_ratio = 0;         // observed fraction of the nodes in a layer (below the top) also in the next
+    std::vector<size_t> layer_nodes;    // number of nodes linked into each layer, bottom layer first
+    std::vector<size_t> height_counts;  // number of towers of each height, height_counts[h - 1] for height h
+    std::vector<double> average_gap;    // average number of elements from one node of each layer to the next
+    size_t node_bytes = 0;              // bytes used by the nodes, links and widths included
+    size_t layer_bytes = 0;             // bytes used by the layer heads
+};
+
+/*
+ * Bounds and pace of skip_list::AutoTune(). p moves between min_p, for lists that only write (fewer links to set and
+ * less memory), and max_p, for lists that only read (more layers and shorter searches).
+ */
+struct skip_list_tuning
+{
+    float min_p = 0.125f;
+    float max_p = 0.5f;
+    unsigned window = 4096;     // number of operations observed between adjustments of p
+    unsigned sample = 64;       // one in sample operations has the length of its search measured
+};
+
+/* selects the skip_list constructor that builds the list in one pass from input already sorted by Compare */
+struct skip_list_sorted_tag { explicit skip_list_sorted_tag() = default; };
+inline constexpr skip_list_sorted_tag sorted_tag{};
+
+/* holds the comparator of a skip list, empty comparators are a base class so they take up no space */
+template <typename Compare, bool = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+class skip_list_compare : private Compare
+{
+public:
+    explicit skip_list_compare(const Compare& compare) : Compare(compare) {}
+    const Compare& comp() const { return *this; }
+};
+
+template <typename Compare>
+class skip_list_compare<Compare, false>
+{
+public:
+    explicit skip_list_compare(const Compare& compare) : compare_(compare) {}
+    const Compare& comp() const { return compare_; }
+
+private:
+    Compare compare_;
 };
 
 
 /*
  * Skip List implementation, based on https://en.wikipedia.org/wiki/Skip_list. Randomly inserts in new nodes into higher layers.
+ * Each element is stored in a single tower node, layers_ holds the first node of each layer.
+ * Nodes are allocated through Allocator (rebound to node storage), see skip_list_pool.h for a pooled allocator.
+ * Tower heights come from LevelGenerator, see skip_list_level.h.
+ * Elements are ordered by Compare. If Compare has an is_transparent member type (e.g. std::less<>), Contains(), Find()
+ * and Remove() also accept any key type comparable with T, avoiding a temporary T.
+ * Searches normally start from the top of the list. The hinted overloads start from an iterator instead, and UseFinger()
+ * makes every operation start from the search path of the previous one, so keys close together cost O(log d) in their
+ * distance d rather than O(logn).
+ * With IndexPolicy skip_list_indexed, elements can also be reached by position, see indexed_skip_list.
+ * With LinkPolicy skip_list_singly_linked, towers keep no link back to the previous element, see skip_list_singly_linked.
  */
-template <typename T>
-class skip_list
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator, typename IndexPolicy = skip_list_unindexed,
+          typename LinkPolicy = skip_list_doubly_linked>
+class skip_list : private skip_list_compare<Compare>
 {
+    // true if nodes link back to the node before them, see skip_list_doubly_linked
+    static constexpr bool linked = LinkPolicy::linked;
+
 public:
-    // Constructor
-    skip_list(float p = 0.5);
+    using value_type = T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    struct iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    // Constructor, levels are generated from a random seed
+    skip_list(float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator());
+
+    // Constructor, levels are generated from seed so the structure is reproducible
+    skip_list(float p, std::uint64_t seed, const Compare& compare = Compare(), const Allocator& allocator = Allocator());
 
-    // Copy constructor
+    // Constructor, builds the list in O(n) from [first, last) which must be sorted by Compare, see AssignSorted()
+    template <typename InputIt>
+    skip_list(InputIt first, InputIt last, skip_list_sorted_tag, float p = 0.5, const Compare& compare = Compare(),
+              const Allocator& allocator = Allocator());
+
+    // Copy constructor, copies the structure of other (tower heights included) in O(n)
     skip_list(const skip_list& other);
 
     // Move constructor
     skip_list(skip_list&& other) noexcept;
 
-    // Assignment
+    // Assignment, copies the structure of other in O(n)
     skip_list& operator=(const skip_list& other);
 
     // Move assignment
@@ -59,13 +231,140 @@ public:
     ~skip_list();
     
     // returns true if list contains val
-    bool Contains(T val);
+    bool Contains(const T& val) const { return FindNode(val); }
+
+    // returns true if list contains an element equivalent to key (transparent Compare only)
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool Contains(const K& key) const { return FindNode(key); }
+
+    // returns an iterator to an element equal to val, or end() if val is not in the list
+    auto Find(const T& val) const { return iterator(FindNode(val), this); }
+
+    // returns an iterator to an element equivalent to key, or end() (transparent Compare only)
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    auto Find(const K& key) const { return iterator(FindNode(key), this); }
+
+    // returns an iterator to an element equal to val, searching forward from hint. Hints after val are ignored
+    iterator Find(iterator hint, const T& val) const;
+
+    // returns an iterator to the first element not less than val, or end() if there is none
+    auto LowerBound(const T& val) const { return iterator(Locate<false>(val), this); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    auto LowerBound(const K& key) const { return iterator(Locate<false>(key), this); }
+
+    // returns an iterator to the first element not less than val, searching forward from hint. Hints after val are ignored
+    iterator LowerBound(iterator hint, const T& val) const { return iterator(HintPath<false>(hint.node_, val, nullptr, nullptr, 1), this); }
+
+    // returns an iterator to the first element greater than val, or end() if there is none
+    auto UpperBound(const T& val) const { return iterator(Locate<true>(val), this); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    auto UpperBound(const K& key) const { return iterator(Locate<true>(key), this); }
+
+    // writes to out[i] whether the i-th element of [first, last) is in the list, returns out + (last - first). The
+    // searches are interleaved so their cache misses overlap, see SearchBatch(). out must be random access
+    template <typename RandomIt, typename OutputIt>
+    OutputIt ContainsBatch(RandomIt first, RandomIt last, OutputIt out) const;
+
+    // writes to out[i] an iterator to an element equal to the i-th element of [first, last), or end(), returns
+    // out + (last - first). out must be random access
+    template <typename RandomIt, typename OutputIt>
+    OutputIt FindBatch(RandomIt first, RandomIt last, OutputIt out) const;
+
+    // returns the largest element (the last of equal ones) in O(logn), throws std::out_of_range if the list is empty
+    const T& Back() const;
+
+    // returns an iterator to the largest element (the last of equal ones) in O(logn), or end() if the list is empty
+    iterator Max() const { return iterator(BackNode(), this); }
+
+    // returns the range of elements equal to val as a pair of iterators [LowerBound(val), UpperBound(val))
+    auto EqualRange(const T& val) const { return std::make_pair(LowerBound(val), UpperBound(val)); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    auto EqualRange(const K& key) const { return std::make_pair(LowerBound(key), UpperBound(key)); }
 
     // insert val into its sorted position in the list
-    void Insert(T val);
+    void Insert(const T& val) { Emplace(val); }
+    void Insert(T&& val) { Emplace(std::move(val)); }
+
+    // construct an element in place from args and insert it into its sorted position in the list
+    template <typename... Args>
+    void Emplace(Args&&... args);
+
+    // insert val searching forward from hint, an element at or before the position of val. Returns the inserted element
+    iterator Insert(iterator hint, const T& val) { return EmplaceHint(hint, val); }
+    iterator Insert(iterator hint, T&& val) { return EmplaceHint(hint, std::move(val)); }
+
+    // construct an element in place from args and insert it searching forward from hint. Returns the inserted element
+    template <typename... Args>
+    iterator EmplaceHint(iterator hint, Args&&... args);
 
     // remove val from list, returns false if val not in list
-    bool Remove(T val);
+    bool Remove(const T& val) { return RemoveKey(val); }
+
+    // remove an element equivalent to key, returns false if there is none (transparent Compare only)
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool Remove(const K& key) { return RemoveKey(key); }
+
+    // removes all elements in [lo, hi), returns the number of elements removed
+    size_t EraseRange(const T& lo, const T& hi) { return RemoveRange(lo, hi); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t EraseRange(const K& lo, const K& hi) { return RemoveRange(lo, hi); }
+
+    // indexed lists only: returns the number of elements less than val
+    size_t Rank(const T& val) const { return RankOf(val); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t Rank(const K& key) const { return RankOf(key); }
+
+    // indexed lists only: returns the element at position k (0 is the smallest), throws std::out_of_range if k >= Size()
+    const T& At(size_t k) const;
+
+    // indexed lists only: returns an iterator to the element at position k, or end() if k >= Size()
+    iterator Select(size_t k) const { return iterator(k < size_ ? SelectNode(k + 1, nullptr, nullptr) : nullptr, this); }
+
+    // indexed lists only: removes the element at position k, returns false if k >= Size()
+    bool EraseAt(size_t k);
+
+    // indexed lists only: returns the number of elements in [lo, hi)
+    size_t CountRange(const T& lo, const T& hi) const { return Less(lo, hi) ? RankOf(hi) - RankOf(lo) : 0; }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t CountRange(const K& lo, const K& hi) const { return Less(lo, hi) ? RankOf(hi) - RankOf(lo) : 0; }
+
+    // replaces the contents of the list with [first, last), which must be sorted by Compare, in O(n)
+    template <typename InputIt>
+    void AssignSorted(InputIt first, InputIt last);
+
+    // moves every element of other into its sorted position, after equal elements of this list, leaving other empty.
+    // Towers are relinked, not copied, in O(n + m), or O(m log(n/m)) when one list is much smaller. If the allocators
+    // differ the elements are copied instead
+    void Merge(skip_list&& other);
+
+    // returns a new list of the elements in this list or other, counting equal elements like std::set_union, in O(n + m)
+    skip_list Union(const skip_list& other) const { return Combine<true, true, true>(other); }
+
+    // returns a new list of the elements in both lists, like std::set_intersection. O(n + m), or O(m log(n/m)) when one
+    // list is much smaller
+    skip_list Intersect(const skip_list& other) const { return Combine<false, false, true>(other); }
+
+    // returns a new list of the elements in this list but not in other, like std::set_difference. O(n + m), or
+    // O(n log(m/n)) when this list is much smaller
+    skip_list Difference(const skip_list& other) const { return Combine<true, false, false>(other); }
+
+    // moves every element not less than key into a new list and returns it, cutting each layer at key in O(logn). Only
+    // indexed lists know how many elements are on each side, other lists count the smaller side in O(min(k, n - k))
+    skip_list Split(const T& key) { return SplitAt(key); }
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    skip_list Split(const K& key) { return SplitAt(key); }
+
+    // appends every element of other, which must not be less than any element of this list, leaving other empty. Each
+    // layer of other is linked after the last tower of that layer in O(logn). If the allocators differ the elements are
+    // copied instead
+    void Join(skip_list&& other);
 
     // removes all elements form the list
     void Clear();
@@ -73,270 +372,1273 @@ public:
     // returns the number of elements in the list
     size_t Size() const { return size_; }
 
+    // returns the probability that an element is promoted to the next higher layer
+    float P() const { return generator_.P(); }
+
+    // returns the comparator ordering the list
+    Compare key_comp() const { return this->comp(); }
+
+    // when enabled, every operation starts searching from the path of the previous operation (the last finger).
+    // Lookups then update the list, so a list using a finger must not be read from several threads at once
+    void UseFinger(bool enabled);
+
+    // returns true if searches start from the last finger
+    bool UsesFinger() const { return finger_enabled_; }
+
+    // caps new towers at height layers, or with 0 (the default) at floor(log_1/p(n)) + 1 for a list of n elements.
+    // Towers already in the list keep their height until RebuildLayers()
+    void SetHeightCap(unsigned height);
+
+    // returns the height cap set with SetHeightCap(), 0 if it follows the size of the list
+    unsigned HeightCap() const { return height_cap_; }
+
+    // when enabled, the list counts reads and writes and measures a sample of its searches, and every tuning.window
+    // operations moves p toward tuning.max_p as reads dominate or toward tuning.min_p as writes do. If searches grow
+    // well past what p should give, Insert() or Remove() rebuilds the layers once enough operations have passed to pay
+    // for it, invalidating iterators. Lookups then update the list, so it must not be read from several threads at once
+    void AutoTune(bool enabled, const skip_list_tuning& tuning = skip_list_tuning());
+
+    // returns true if the list tunes p as it runs
+    bool AutoTunes() const { return tuning_.enabled; }
+
+    // rebuilds every layer with evenly spaced towers for the current p and height cap, copying each element once in
+    // O(n). Invalidates iterators
+    void RebuildLayers();
+
     // print the skip list to standard output. If internal_representation is true, all layers will be displayed
     void Print(bool internal_rep = false);
+
+    // returns the number of bytes used by the nodes and layer heads of the list
+    size_t MemoryUsage() const;
+
+    // returns the average number of layers each element is linked into
+    double AverageHeight() const;
+
+    // returns the number of nodes in each layer, the number of towers of each height, the observed promotion ratio, the
+    // average gap in each layer, and the bytes used. Walks the list in O(n), or takes O(logn) while tracking stats
+    skip_list_stats Stats() const;
+
+    // when enabled, the list keeps count of its towers by height as elements come and go, so Stats() doesn't walk it.
+    // Enabling it counts the towers once in O(n)
+    void TrackStats(bool enabled);
+
+    // returns true if the list keeps count of its towers for Stats()
+    bool TracksStats() const { return track_stats_; }
+
+    // writes the list to path in the format of skip_list_file.h, tower heights included, for mapped_skip_list to serve
+    // without rebuilding. T must be trivially copyable. Throws std::runtime_error if the file can't be written
+    void Save(const std::string& path) const;
     
 private:
-    std::vector<skip_list_node<T>*> layers_;
+    using node_storage = skip_list_node_storage<T>;
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node_storage>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    // upper bound on the number of layers, sizes the search path arrays kept on the stack
+    static constexpr unsigned max_layers = 64;
+
+    // true if links store their widths
+    static constexpr bool indexed = IndexPolicy::indexed;
+
+    std::vector<skip_list_node<T, LinkPolicy::linked>*> layers_;
     size_t size_;
-    float p_;
+    LevelGenerator generator_;
+    node_allocator allocator_;
+    bool finger_enabled_;
+    bool track_stats_;
+    unsigned height_cap_;       // 0 follows the size of the list, see SetHeightCap()
+
+    // search path of the last operation when using a finger, empty if there is none yet
+    mutable std::vector<skip_list_node<T, LinkPolicy::linked>*> finger_;
+    mutable std::vector<size_t> finger_ranks_;
+
+    // width of the link from the start of each layer to its first node, indexed lists only
+    std::vector<size_t> head_widths_;
+
+    // number of towers of each height while tracking stats, heights_[h - 1] for height h. Heights past the end count 0
+    std::vector<size_t> heights_;
+
+    // auto-tuning settings, and what was observed since p was last adjusted
+    struct tuning_state
+    {
+        skip_list_tuning bounds;
+        bool enabled = false;
+        size_t reads = 0;
+        size_t writes = 0;
+        size_t sampled = 0;         // number of searches measured
+        size_t hops = 0;            // nodes compared by the measured searches
+        size_t since_change = 0;    // operations since p changed or the layers were rebuilt
+    };
+    mutable tuning_state tuning_;
+
+    template <typename, typename, typename, typename, typename> friend class skip_map;
+
+    // allocates a tower node with room for height links and constructs its value from args
+    template <typename... Args>
+    skip_list_node<T, LinkPolicy::linked>* CreateNode(unsigned height, Args&&... args);
+
+    // destroys and frees a node allocated with CreateNode()
+    void DestroyNode(skip_list_node<T, LinkPolicy::linked>* node);
+
+    // counts a tower of height joining the list while tracking stats
+    void CountTower(unsigned height)
+    {
+        if (!track_stats_) return;
+        if (heights_.size() < height) heights_.resize(height);
+        ++heights_[height - 1];
+    }
+
+    // counts a tower of height leaving the list while tracking stats
+    void UncountTower(unsigned height) { if (track_stats_) --heights_[height - 1]; }
+
+    // adds the heights of the towers from node up to end in the bottom layer to heights
+    static void CountHeights(const skip_list_node<T, LinkPolicy::linked>* node, const skip_list_node<T, LinkPolicy::linked>* end, std::vector<size_t>& heights);
+
+    // counts the towers of other joining the list while tracking stats, from other's counts if it keeps them
+    void CountList(const skip_list& other);
+
+    // number of storage units needed for a node with height links
+    static constexpr size_t NodeUnits(unsigned height)
+    {
+        return (skip_list_node<T, LinkPolicy::linked>::Bytes(height, indexed) + sizeof(node_storage) - 1) / sizeof(node_storage);
+    }
+
+    // width of the link after node in layer, node null is the start of the layer
+    size_t& Width(skip_list_node<T, LinkPolicy::linked>* node, unsigned layer) { return node ? node->width(layer) : head_widths_[layer]; }
+    size_t Width(const skip_list_node<T, LinkPolicy::linked>* node, unsigned layer) const { return node ? node->width(layer) : head_widths_[layer]; }
 
     // finds the first node matching val in any layer, starting search from highest layer
-    skip_list_node<T>* Find(T val, int& layer);
-    
-    // less than or equal comparison using only < operator
-    inline static bool Less_Or_Equal(T a, T b){ return !(b < a); }
+    template <typename K>
+    skip_list_node<T, LinkPolicy::linked>* FindNode(const K& val) const;
+
+    // appends a copy of every tower of other to this empty list, keeping heights (and widths)
+    void CloneFrom(const skip_list& other);
+
+    // links node as the new last element after the last node of each layer in tail (at positions tail_ranks)
+    void AppendNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** tail, size_t* tail_ranks);
+
+    // sets the widths of the links at the end of each layer after appending, indexed lists only
+    void FinishAppend(skip_list_node<T, LinkPolicy::linked>* const* tail, const size_t* tail_ranks);
+
+    // a list at least this many times larger than the other is searched from the smaller one instead of walked
+    static constexpr size_t gallop_ratio = 8;
+
+    // moves the towers of other into this list one at a time, by finger search
+    template <bool AfterEqual>
+    void SpliceEach(skip_list& other);
+
+    // new list of the elements only in this list, only in other, and in both, as selected
+    template <bool OnlyThis, bool OnlyOther, bool Both>
+    skip_list Combine(const skip_list& other) const;
+
+    // moves the elements from key on into a new list
+    template <typename K>
+    skip_list SplitAt(const K& key);
+
+    // removes the first node matching val
+    template <typename K>
+    bool RemoveKey(const K& val);
+
+    // removes all nodes in [lo, hi)
+    template <typename K>
+    size_t RemoveRange(const K& lo, const K& hi);
+
+    // unlinks node from its layers after the nodes in up, dropping layers left empty
+    void UnlinkNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** up);
+
+    // pops empty layers from the top of the list
+    void DropEmptyLayers();
+
+    // number of elements less than val, indexed lists only
+    template <typename K>
+    size_t RankOf(const K& val) const;
+
+    // returns the node at 1 based position rank, filling up and ranks (if not null) with the path to it
+    skip_list_node<T, LinkPolicy::linked>* SelectNode(size_t rank, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks) const;
+
+    // returns the last node, or null if the list is empty
+    skip_list_node<T, LinkPolicy::linked>* BackNode() const;
+
+    // returns the node before node in the bottom layer, or null if node is the first. Searches for it in singly linked lists
+    skip_list_node<T, LinkPolicy::linked>* PrevNode(const skip_list_node<T, LinkPolicy::linked>* node) const;
+
+    // inserts a node constructed from key and args unless an equivalent element exists, returns the node and whether
+    // it was inserted
+    template <typename K, typename... Args>
+    std::pair<skip_list_node<T, LinkPolicy::linked>*, bool> EmplaceUnique(K&& key, Args&&... args);
+
+    // fills up (if not null) with the last node before val in each layer, returns the node after that position in the
+    // bottom layer
+    // In indexed lists ranks (if not null) is filled with the position of each node in up (0 for the layer start).
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* FindPath(const K& val, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks = nullptr) const
+    {
+        return SearchDown<AfterEqual>(nullptr, static_cast<unsigned>(layers_.size()), val, up, ranks, 0);
+    }
+
+    // FindPath() starting from current (nullptr for the layer heads) at position rank in the first layers layers
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* SearchDown(skip_list_node<T, LinkPolicy::linked>* current, unsigned layers, const K& val, skip_list_node<T, LinkPolicy::linked>** up,
+                                                      size_t* ranks, size_t rank) const;
+
+    // FindPath() starting from the last finger
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* FingerPath(const K& val, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks) const
+    {
+        if (finger_.empty()) return FindPath<AfterEqual>(val, up, ranks);
+        assert(finger_.size() == layers_.size());
+        return PathFrom<AfterEqual>(val, finger_.data(), finger_ranks_.data(), up, ranks);
+    }
+
+    // FindPath() starting from from, the path to another position (and its ranks), which may be up itself
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* PathFrom(const K& val, skip_list_node<T, LinkPolicy::linked>* const* from, const size_t* from_ranks, skip_list_node<T, LinkPolicy::linked>** up,
+                                                    size_t* ranks) const;
+
+    // FindPath() from the last finger if enabled, otherwise from the top
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* SearchPath(const K& val, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks) const
+    {
+        return finger_enabled_ ? FingerPath<AfterEqual>(val, up, ranks) : FindPath<AfterEqual>(val, up, ranks);
+    }
+
+    // number of searches SearchBatch() keeps in flight at once
+    static constexpr unsigned batch_group = 16;
+
+    // searches for every element of [first, first + count) at once, calling done(i, node) with the first node not less
+    // than the i-th element (null if there is none) as each search finishes
+    template <typename RandomIt, typename Done>
+    void SearchBatch(RandomIt first, size_t count, Done&& done) const;
+
+    // hints the processor to start loading node into cache
+    static void Prefetch(const skip_list_node<T, LinkPolicy::linked>* node)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(node);
+#else
+        (void)node;
+#endif
+    }
+
+    // position of val without a path, from the last finger (which is then moved to val) if enabled
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* Locate(const K& val) const;
+
+    // FindPath() climbing forward from hint, filling at least the first height layers of up (if not null)
+    template <bool AfterEqual, typename K>
+    skip_list_node<T, LinkPolicy::linked>* HintPath(skip_list_node<T, LinkPolicy::linked>* hint, const K& val, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks,
+                                                    unsigned height) const;
+
+    // keeps up (and ranks in indexed lists) as the last finger
+    void SaveFinger(skip_list_node<T, LinkPolicy::linked>* const* up, const size_t* ranks) const
+    {
+        finger_.assign(up, up + layers_.size());
+        if constexpr (indexed) finger_ranks_.assign(ranks, ranks + layers_.size());
+    }
+
+    // links node into its layers after the nodes in up, at the positions in ranks
+    void LinkNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks);
+
+    // random height for a new tower
+    unsigned RandomHeight();
+
+    // upper bound on the height of a tower in a list of size elements
+    unsigned MaxHeight(size_t size) const;
+
+    // counts a read (or a write) of val while auto-tuning, measuring the search for it if it is in the sample
+    template <typename K>
+    void Observe(const K& val, bool write) const;
 
-    // equality comparison using only < operator
-    inline static bool Equal(T a, T b) { return !(a < b || b < a); }
+    // adjusts p once a window of operations has been observed, and rebuilds the layers if searches have grown too long.
+    // Returns true if it rebuilt them
+    bool Tune();
+
+    // expected number of nodes compared by a search in a list of size elements built with p
+    static double ExpectedHops(size_t size, float p);
+
+    // less than comparison using Compare
+    template <typename A, typename B>
+    bool Less(const A& a, const B& b) const { return this->comp()(a, b); }
+
+    // less than or equal comparison using only Compare
+    template <typename A, typename B>
+    bool Less_Or_Equal(const A& a, const B& b) const { return !this->comp()(b, a); }
+
+    // equality comparison using only Compare
+    template <typename A, typename B>
+    bool Equal(const A& a, const B& b) const { return !(this->comp()(a, b) || this->comp()(b, a)); }
+
+    // true if node comes before the position of val (before equal elements, or after them if AfterEqual)
+    template <bool AfterEqual, typename K>
+    bool Before(const skip_list_node<T, LinkPolicy::linked>* node, const K& val) const
+    {
+        return AfterEqual ? Less_Or_Equal(node->val, val) : Less(node->val, val);
+    }
 
     
-    // forward read only iterator
+    // bidirectional read only iterator, decrementing end() gives the last element
 public:
     struct iterator 
     {
-        using iterator_category = std::forward_iterator_tag;
+        using iterator_category = std::bidirectional_iterator_tag;
         using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
 
-        explicit iterator(skip_list_node<T>* node) : node_(node) {}
+        iterator() : node_(nullptr), list_(nullptr) {}
+        iterator(skip_list_node<T, LinkPolicy::linked>* node, const skip_list* list) : node_(node), list_(list) {}
         
         const T& operator*() const { return node_->val; }
-        const T* operator->() const { return *(node_->val); }
+        const T* operator->() const { return &node_->val; }
 
         // Prefix increment
-        iterator& operator++() { node_ = node_->next; return *this; }  
+        iterator& operator++() { node_ = node_->next(0); return *this; }  
 
         // Postfix increment
         iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        // Prefix decrement, O(1) in doubly linked lists, O(logn) in singly linked lists
+        iterator& operator--()
+        {
+            node_ = node_ ? list_->PrevNode(node_) : list_->BackNode();
+            return *this;
+        }
+
+        // Postfix decrement
+        iterator operator--(int) { iterator tmp = *this; --(*this); return tmp; }
         
         friend bool operator== (const iterator& a, const iterator& b) { return a.node_ == b.node_; }
         friend bool operator!= (const iterator& a, const iterator& b) { return a.node_ != b.node_; }
         
     private:
-        skip_list_node<T>* node_;
+        friend class skip_list;
+        skip_list_node<T, LinkPolicy::linked>* node_;
+        const skip_list* list_;
     };
     
-    iterator begin() const { return iterator(!layers_.empty() ? layers_.front() : nullptr); }
+    iterator begin() const { return iterator(!layers_.empty() ? layers_.front() : nullptr, this); }
     
-    iterator end() const { return iterator(nullptr); }
+    iterator end() const { return iterator(nullptr, this); }
+
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
 };
 
+/* skip_list with O(logn) positional access, see skip_list_indexed */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator>
+using indexed_skip_list = skip_list<T, Compare, Allocator, LevelGenerator, skip_list_indexed>;
+
 
 /* Skip List. p is the probability (must be in range [0,1]) that an inserted element will be inserted into a higher layer. */
-template <typename T>
-skip_list<T>::skip_list(float p) : size_(0), p_(p)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::skip_list(float p, const Compare& compare, const Allocator& allocator)
+    : skip_list_compare<Compare>(compare), size_(0), generator_(p), allocator_(allocator), finger_enabled_(false), track_stats_(false), height_cap_(0)
+{
+    assert(p >= 0 && p <= 1);
+}
+
+/* Skip List with levels generated from seed. */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::skip_list(float p, std::uint64_t seed, const Compare& compare,
+                                                            const Allocator& allocator)
+    : skip_list_compare<Compare>(compare), size_(0), generator_(p, seed), allocator_(allocator), finger_enabled_(false), track_stats_(false), height_cap_(0)
 {
     assert(p >= 0 && p <= 1);
 }
 
+/* Skip List built from sorted input, see AssignSorted() */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename InputIt>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::skip_list(InputIt first, InputIt last, skip_list_sorted_tag, float p,
+                                                            const Compare& compare, const Allocator& allocator)
+    : skip_list(p, compare, allocator)
+{
+    AssignSorted(first, last);
+}
+
 /* Copy constructor */
-template <typename T>
-skip_list<T>::skip_list(const skip_list& other)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::skip_list(const skip_list& other)
+    : skip_list_compare<Compare>(other.comp()), size_(0), generator_(other.generator_),
+      allocator_(node_traits::select_on_container_copy_construction(other.allocator_)), finger_enabled_(other.finger_enabled_),
+      track_stats_(other.track_stats_), height_cap_(other.height_cap_), tuning_(other.tuning_)
 {
-    auto current = other.layers_[0];
-    p_ = other.p_;
-    while (current)
-    {
-        skip_list<T>::Insert(current->val);
-        current = current->next;
-    }
+    CloneFrom(other);
 }
 
-/* Move copy constructor */
-template <typename T>
-skip_list<T>::skip_list(skip_list&& other) noexcept: layers_(std::move(other.layers_)),size_(other.size_), p_(other.p_) {}
+/* Move copy constructor. other keeps a fresh allocator so it stays usable without sharing our nodes' memory */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::skip_list(skip_list&& other) noexcept
+    : skip_list_compare<Compare>(other.comp()), layers_(std::move(other.layers_)), size_(other.size_),
+      generator_(other.generator_), allocator_(other.allocator_), finger_enabled_(other.finger_enabled_),
+      track_stats_(other.track_stats_), height_cap_(other.height_cap_), finger_(std::move(other.finger_)),
+      finger_ranks_(std::move(other.finger_ranks_)), head_widths_(std::move(other.head_widths_)),
+      heights_(std::move(other.heights_)), tuning_(other.tuning_)
+{
+    other.layers_.clear();
+    other.finger_.clear();
+    other.head_widths_.clear();
+    other.heights_.clear();
+    other.size_ = 0;
+    other.allocator_ = node_traits::select_on_container_copy_construction(allocator_);
+}
 
 /* Assignment */
-template <typename T>
-skip_list<T>& skip_list<T>::operator=(const skip_list& other)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>& skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::operator=(const skip_list& other)
 {
+    if (this == &other)
+        return *this;
     Clear();
-    auto node = other.layers_[0];
-    while (node)
-    {
-        Insert(node->val);
-        node = node->next;
-    }
+    if (node_traits::propagate_on_container_copy_assignment::value) allocator_ = other.allocator_;
+    generator_ = other.generator_;
+    finger_enabled_ = other.finger_enabled_;
+    track_stats_ = other.track_stats_;
+    height_cap_ = other.height_cap_;
+    tuning_ = other.tuning_;
+    static_cast<skip_list_compare<Compare>&>(*this) = other;
+    CloneFrom(other);
     return *this;
 }
 
 /* Move Assignment */
-template <typename T>
-skip_list<T>& skip_list<T>::operator=(skip_list&& other) noexcept
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>& skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::operator=(skip_list&& other) noexcept
 {
     if (this == &other)
         return *this;
+    Clear();
+    generator_ = other.generator_;
+    finger_enabled_ = other.finger_enabled_;
+    track_stats_ = other.track_stats_;
+    height_cap_ = other.height_cap_;
+    tuning_ = other.tuning_;
+    static_cast<skip_list_compare<Compare>&>(*this) = other;
+
+    // allocators that don't propagate and don't match can't take over the other list's nodes
+    if (!node_traits::propagate_on_container_move_assignment::value && !(allocator_ == other.allocator_))
+    {
+        for (const auto& val : other) Insert(val);
+        other.Clear();
+        return *this;
+    }
+
     layers_ = std::move(other.layers_);
     size_ = other.size_;
-    p_ = other.p_;
+    allocator_ = other.allocator_;
+    finger_ = std::move(other.finger_);
+    finger_ranks_ = std::move(other.finger_ranks_);
+    head_widths_ = std::move(other.head_widths_);
+    heights_ = std::move(other.heights_);
+    other.layers_.clear();
+    other.finger_.clear();
+    other.head_widths_.clear();
+    other.heights_.clear();
+    other.size_ = 0;
+    other.allocator_ = node_traits::select_on_container_copy_construction(allocator_);
     return *this;
 }
 
 /* Destructor */
-template <typename T>
-skip_list<T>::~skip_list()
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::~skip_list()
 {
     Clear();
 }
 
 /*
- * returns true if val is in the list, false otherwise
+ * Constructs an element from args directly in a new tower node, then links the node into its sorted position in the
+ * skip list. The element is built exactly once and the search path is kept on the stack.
  */
-template <typename T>
-bool skip_list<T>::Contains(T val)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename... Args>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Emplace(Args&&... args)
 {
-    int layer;
-    return Find(val, layer);   
+    auto new_node = CreateNode(RandomHeight(), std::forward<Args>(args)...);
+
+    // insert after any equal elements
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    SearchPath<true>(new_node->val, up, ranks);
+    LinkNode(new_node, up, ranks);
+    if (finger_enabled_) SaveFinger(up, ranks);
+
+    if (tuning_.enabled)
+    {
+        Observe(new_node->val, true);
+        Tune();
+    }
 }
 
 /*
- * Inserts val in its sorted position in the skip list
+ * Constructs an element from args in a new tower node and links it into its sorted position, found by climbing
+ * forward from hint instead of searching from the top. Falls back to a full search if hint is end() or after the new
+ * element, or if no tower reached from hint is tall enough to link the new one. Indexed lists always search from the
+ * top, since linking needs the absolute position of the new element.
  */
-template <typename T>
-void skip_list<T>::Insert(T val)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename... Args>
+typename skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::iterator
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::EmplaceHint(iterator hint, Args&&... args)
 {
-    // increment size (will not fail)
-    ++size_;
+    // tuned before the tower exists, since a rebuild moves every node and would leave hint and the result dangling
+    if (tuning_.enabled && Tune()) hint = end();
 
-    // first element
-    if (layers_.empty())
+    auto new_node = CreateNode(RandomHeight(), std::forward<Args>(args)...);
+    if (tuning_.enabled) Observe(new_node->val, true);
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    const auto height = std::min(new_node->height, static_cast<unsigned>(layers_.size()));
+    HintPath<true>(hint.node_, new_node->val, up, ranks, height);
+    LinkNode(new_node, up, ranks);
+
+    // layers above the towers visited from hint aren't known, so the last finger can't be kept
+    finger_.clear();
+    return iterator(new_node, this);
+}
+
+/*
+ * Inserts an element constructed from key and args only if no element equivalent to key is in the list.
+ * Returns the node holding key and true if it was inserted, false if it was already present.
+ * The key is searched before anything is allocated, so finding an existing element costs one search.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K, typename... Args>
+std::pair<skip_list_node<T, LinkPolicy::linked>*, bool> skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::EmplaceUnique(K&& key, Args&&... args)
+{
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    auto node = SearchPath<false>(key, up, ranks);
+    if (node && !Less(key, node->val))
     {
-        layers_.push_back(new skip_list_node<T>(val));
-        return;
+        if (finger_enabled_) SaveFinger(up, ranks);
+        return { node, false };
     }
-    
-    // start at highest layer
-    auto layer = layers_.size() - 1;
-    skip_list_node<T>* current = layers_[layer];
-    
-    // move down start of layers if val smaller than current
-    // while (layer > 0 && current->val > val)
-    while (layer > 0 && val < current->val)
-        current = layers_[--layer];
 
-    // cache how to go back up where we went down
-    std::vector<skip_list_node<T>*> up;
-    
-    while (true)
+    // tuned before linking, a rebuild moves every node so the path is searched again
+    if (tuning_.enabled)
     {
-        // search current layer while value is less than current
-        while (current->next && Less_Or_Equal(current->next->val, val)) current = current->next;
-
-        // go down a layer if there is one
-        if (current->down)
-        {
-            --layer;
-            up.push_back(current);
-            current = current->down;
-        }
-        else break;
+        Observe(key, true);
+        if (Tune()) SearchPath<false>(key, up, ranks);
     }
-    
-    skip_list_node<T>* new_node;
-
-    // insert at front
-    if (val < current->val) layers_[0] = new_node = new skip_list_node<T>(val, current);
 
-    // insert inside list
-    else new_node = new skip_list_node<T>(val, current->next, current);
+    // no other node is in the list between up[0] and node, so the path stays valid
+    node = CreateNode(RandomHeight(), std::forward<K>(key), std::forward<Args>(args)...);
+    LinkNode(node, up, ranks);
+    if (finger_enabled_) SaveFinger(up, ranks);
+    return { node, true };
+}
 
-    // reset neighboring links
-    if (new_node->prev) new_node->prev->next = new_node;
-    if (new_node->next) new_node->next->prev = new_node;
+/*
+ * removes the first element matching val from the skip list.
+ * returns true if successful, false if val isn't in the list.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+bool skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::RemoveKey(const K& val)
+{
+    if (tuning_.enabled) Observe(val, true);
 
-    // randomly add node to higher layers
-    auto max_layer = static_cast<unsigned>(floor(std::log(size_)));
-    while (++layer <= max_layer)
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    auto node = SearchPath<false>(val, up, ranks);
+    if (!node || !Equal(node->val, val))
     {
-        // flip a coin on adding this to the next level (probability based on p)
-        if (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) <= p_)
-        {
-            // add to after cached node in layer up
-            if (!up.empty())
-            {
-                auto node = up.back(); up.pop_back();
-                
-                new_node = new skip_list_node<T>(val, node->next, node, new_node);
+        if (finger_enabled_) SaveFinger(up, ranks);
+        return false;
+    }
 
-                // fix neighboring node links
-                new_node->prev->next = new_node;
-                if (new_node->next) new_node->next->prev = new_node;
-            }
+    UnlinkNode(node, up);
+    if (finger_enabled_) SaveFinger(up, ranks);
 
-            // add to new higher layer if needed
-            else if (layers_.size() <= layer)
-            {
-                layers_.push_back(new_node = new skip_list_node<T>(val, nullptr, nullptr, new_node));
-            }
+    DestroyNode(node);
+    --size_;
+    if (tuning_.enabled) Tune();
+    return true;
+}
 
-            // add to start of layer
-            else
-            {
-                new_node = layers_[layer] = new skip_list_node<T>(val, layers_[layer], nullptr, new_node);
-                new_node->next->prev = new_node;
-            }
-                
+/*
+ * Unlinks a tower from every layer it is part of, given the last node before it in each layer. In indexed lists the
+ * links that skipped over it become one shorter.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::UnlinkNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** up)
+{
+    for (unsigned layer = 0; layer < node->height; ++layer)
+    {
+        auto& link = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        link = node->next(layer);
+        if constexpr (indexed) Width(up[layer], layer) += node->width(layer) - 1;
+    }
+    if constexpr (indexed)
+        for (auto layer = node->height; layer < layers_.size(); ++layer) --Width(up[layer], layer);
+
+    if constexpr (linked)
+        if (node->next(0)) node->next(0)->prev = node->prev;
+
+    UncountTower(node->height);
+    DropEmptyLayers();
+}
+
+/*
+ * Pops layers left without nodes from the top of the list.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::DropEmptyLayers()
+{
+    while (!layers_.empty() && !layers_.back())
+    {
+        layers_.pop_back();
+        if constexpr (indexed) head_widths_.pop_back();
+    }
+}
+
+/*
+ * Returns the number of elements less than val, the sum of the widths of the links followed by a search for val.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+size_t skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::RankOf(const K& val) const
+{
+    static_assert(indexed, "Rank() and CountRange() need an indexed skip list");
+
+    if (layers_.empty()) return 0;
+    size_t ranks[max_layers];
+    FindPath<false>(val, nullptr, ranks);
+    return ranks[0];
+}
+
+/*
+ * Finds the node at 1 based position rank by following links while their widths don't pass it.
+ * up and ranks (if not null) receive the last node before the position in each layer and its position.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SelectNode(size_t rank, skip_list_node<T, LinkPolicy::linked>** up,
+                                                                                                                             size_t* ranks) const
+{
+    static_assert(indexed, "At(), Select(), and EraseAt() need an indexed skip list");
+    assert(rank >= 1 && rank <= size_);
+
+    skip_list_node<T, LinkPolicy::linked>* current = nullptr;
+    skip_list_node<T, LinkPolicy::linked>* next = nullptr;
+    size_t position = 0;
+
+    for (auto layer = layers_.size(); layer-- > 0;)
+    {
+        next = current ? current->next(layer) : layers_[layer];
+        while (next && position + Width(current, layer) < rank)
+        {
+            position += Width(current, layer);
+            current = next;
+            next = next->next(layer);
         }
-        else break;
+        if (up) up[layer] = current;
+        if (ranks) ranks[layer] = position;
     }
+
+    return next;
 }
 
 /*
- * removes the first element matching val from the skip list.
- * returns true if successful, false if val isn't in the list.
+ * Returns the element at position k, throws std::out_of_range if there is none.
  */
-template <typename T>
-bool skip_list<T>::Remove(T val)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+const T& skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::At(const size_t k) const
+{
+    if (k >= size_) throw std::out_of_range("skip_list::At() position out of range");
+    return SelectNode(k + 1, nullptr, nullptr)->val;
+}
+
+/*
+ * Returns the largest element, throws std::out_of_range if the list is empty.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+const T& skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Back() const
+{
+    const auto node = BackNode();
+    if (!node) throw std::out_of_range("skip_list::Back() list is empty");
+    return node->val;
+}
+
+/*
+ * Runs each layer to its end from where the layer above ended, then drops down a layer. The express lanes cover the
+ * list the same way they do in a search, so the last node is reached in O(logn) steps instead of walking the bottom
+ * layer.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::BackNode() const
 {
-    int layer;
-    auto current = Find(val, layer);
-    if (current)
+    skip_list_node<T, LinkPolicy::linked>* current = nullptr;
+    for (auto layer = layers_.size(); layer-- > 0;)
     {
-        // remove node and any down nodes connected
-        do 
+        if (!current) current = layers_[layer];
+        while (current->next(layer)) current = current->next(layer);
+    }
+    return current;
+}
+
+/*
+ * In doubly linked lists this is node->prev. Singly linked lists search for the last node before node's value, then
+ * step over the elements equal to it that come before node, which only the bottom layer keeps in order.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::PrevNode(
+    const skip_list_node<T, LinkPolicy::linked>* node) const
+{
+    if constexpr (linked) return node->prev;
+    else
+    {
+        skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+        auto next = FindPath<false>(node->val, up);
+        auto prev = up[0];
+        for (; next != node; next = next->next(0)) prev = next;
+        return prev;
+    }
+}
+
+/*
+ * Removes the element at position k, returns false if k is out of range.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+bool skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::EraseAt(const size_t k)
+{
+    if (k >= size_) return false;
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    auto node = SelectNode(k + 1, up, ranks);
+
+    UnlinkNode(node, up);
+    if (finger_enabled_) SaveFinger(up, ranks);
+
+    DestroyNode(node);
+    --size_;
+    return true;
+}
+
+/*
+ * Removes all elements in [lo, hi). The towers in the interval are unlinked from every layer at once by joining the
+ * search paths to lo and hi, then the nodes are freed walking the bottom layer, so the cost is O(logn + removed).
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+size_t skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::RemoveRange(const K& lo, const K& hi)
+{
+    if (!Less(lo, hi)) return 0;
+
+    // last node before the interval, and last node in the interval, in each layer
+    skip_list_node<T, LinkPolicy::linked>* before[max_layers];
+    skip_list_node<T, LinkPolicy::linked>* last[max_layers];
+    size_t before_ranks[max_layers];
+    size_t last_ranks[max_layers];
+    auto node = FindPath<false>(lo, before, before_ranks);
+    const auto end = FindPath<false>(hi, last, last_ranks);
+    if (node == end) return 0;
+
+    // link the node before the interval to the node after it, layers above the tallest removed tower are unchanged
+    // apart from their widths
+    const size_t removed = indexed ? last_ranks[0] - before_ranks[0] : 0;
+    unsigned layer = 0;
+    for (; layer < layers_.size() && before[layer] != last[layer]; ++layer)
+    {
+        auto& link = before[layer] ? before[layer]->next(layer) : layers_[layer];
+        link = last[layer]->next(layer);
+        if constexpr (indexed)
+            Width(before[layer], layer) = last_ranks[layer] + last[layer]->width(layer) - before_ranks[layer] - removed;
+    }
+    if constexpr (indexed)
+        for (; layer < layers_.size(); ++layer) Width(before[layer], layer) -= removed;
+
+    if constexpr (linked)
+        if (end) end->prev = node->prev;
+
+    DropEmptyLayers();
+    if (finger_enabled_) SaveFinger(before, before_ranks);
+
+    size_t count = 0;
+    while (node != end)
+    {
+        auto next = node->next(0);
+        UncountTower(node->height);
+        DestroyNode(node);
+        node = next;
+        ++count;
+    }
+
+    size_ -= count;
+    return count;
+}
+
+/*
+ * Replaces the contents of the list with the elements of [first, last), which must already be sorted by Compare.
+ * Towers are appended to the end of every layer they are part of, so the whole list is built in a single O(n) pass with
+ * no searching. Heights are assigned deterministically instead of randomly: with step = round(1/p), every step-th
+ * element is promoted to layer 1, every step^2-th to layer 2, and so on, giving evenly spaced layers.
+ * For forward iterators heights are capped using the final size, otherwise using the size so far.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename InputIt>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::AssignSorted(InputIt first, InputIt last)
+{
+    Clear();
+
+    size_t total = 0;
+    if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>::value)
+        total = static_cast<size_t>(std::distance(first, last));
+
+    const auto p = generator_.P();
+    const size_t step = p >= 1 ? 1 : p > 0 ? std::max<size_t>(2, static_cast<size_t>(std::lround(1 / p))) : 0;
+    unsigned max_height = MaxHeight(total);
+
+    // last node of each layer, and its position in indexed lists
+    skip_list_node<T, LinkPolicy::linked>* tail[max_layers];
+    size_t tail_ranks[max_layers];
+
+    try
+    {
+        for (; first != last; ++first)
         {
-            auto node = current;
-            current = current->down;
+            const auto position = size_ + 1;
+            if (!total) max_height = MaxHeight(position);
+
+            // number of times position divides by step
+            unsigned height = step == 1 ? max_height : 1;
+            for (auto i = position; step > 1 && height < max_height && i % step == 0; i /= step) ++height;
+
+            auto node = CreateNode(height, *first);
+            assert(size_ == 0 || Less_Or_Equal(tail[0]->val, node->val));
+            AppendNode(node, tail, tail_ranks);
+        }
+    }
+    catch (...)
+    {
+        FinishAppend(tail, tail_ranks);
+        throw;
+    }
+    FinishAppend(tail, tail_ranks);
+}
+
+/*
+ * Links node as the new last element at the end of each of its layers, after the nodes in tail, and moves tail to it.
+ * In indexed lists the link from each tail gets its width from the positions in tail_ranks, the links at the end of
+ * each layer reach past the last element and are set by FinishAppend() once all elements are in.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::AppendNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** tail,
+                                                                                           size_t* tail_ranks)
+{
+    const auto position = size_ + 1;
+    if constexpr (linked) node->prev = size_ ? tail[0] : nullptr;
+
+    for (unsigned layer = 0; layer < node->height; ++layer)
+    {
+        if (layer == layers_.size())
+        {
+            layers_.push_back(node);
+            if constexpr (indexed) head_widths_.push_back(position);
+        }
+        else
+        {
+            tail[layer]->next(layer) = node;
+            if constexpr (indexed) tail[layer]->width(layer) = position - tail_ranks[layer];
+        }
+        node->next(layer) = nullptr;
+        tail[layer] = node;
+        if constexpr (indexed) tail_ranks[layer] = position;
+    }
+    CountTower(node->height);
+    ++size_;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::FinishAppend(skip_list_node<T, LinkPolicy::linked>* const* tail, const size_t* tail_ranks)
+{
+    if constexpr (indexed)
+        for (unsigned layer = 0; layer < layers_.size(); ++layer) tail[layer]->width(layer) = size_ + 1 - tail_ranks[layer];
+}
+
+/*
+ * Lists of similar size are merged in one pass over both bottom layers, relinking every tower onto the end of its
+ * layers as AssignSorted() does. When one list is gallop_ratio times smaller its towers are spliced into the larger one
+ * instead, each found by a finger search from the one before, so only O(m log(n/m)) nodes are visited. When that is
+ * this list, the structures are swapped first and its towers go in before equal elements, keeping them first.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Merge(skip_list&& other)
+{
+    if (&other == this || other.size_ == 0) return;
+
+    // our allocator must be able to free every node we end up with
+    if (allocator_ != other.allocator_)
+    {
+        for (const auto& val : other) Insert(val);
+        other.Clear();
+        return;
+    }
+
+    finger_.clear();
+    other.finger_.clear();
 
-            // adjust links
-            if (node->next) node->next->prev = node->prev;
-            if (node->prev) node->prev->next = node->next;
+    if (other.size_ * gallop_ratio < size_) return SpliceEach<true>(other);
+    if (size_ * gallop_ratio < other.size_)
+    {
+        // our towers are counted again as they are linked into other's
+        heights_.clear();
+        CountList(other);
+        std::swap(layers_, other.layers_);
+        std::swap(head_widths_, other.head_widths_);
+        std::swap(size_, other.size_);
+        return SpliceEach<false>(other);
+    }
+
+    auto a = layers_.empty() ? nullptr : layers_.front();
+    auto b = other.layers_.front();
+    layers_.clear();
+    head_widths_.clear();
+    heights_.clear();
+    size_ = 0;
+    other.layers_.clear();
+    other.head_widths_.clear();
+    other.heights_.clear();
+    other.size_ = 0;
+
+    skip_list_node<T, LinkPolicy::linked>* tail[max_layers];
+    size_t tail_ranks[max_layers];
+    while (a || b)
+    {
+        // equal elements of this list first
+        auto& from = b && (!a || Less(b->val, a->val)) ? b : a;
+        const auto node = from;
+        from = node->next(0);
+        AppendNode(node, tail, tail_ranks);
+    }
+    FinishAppend(tail, tail_ranks);
+}
+
+/*
+ * Moves every tower of other into this list in order, searching for each from the path to the one before.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool AfterEqual>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SpliceEach(skip_list& other)
+{
+    auto node = other.size_ ? other.layers_.front() : nullptr;
+    other.layers_.clear();
+    other.head_widths_.clear();
+    other.heights_.clear();
+    other.size_ = 0;
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    while (node)
+    {
+        const auto next = node->next(0);
+        for (unsigned layer = 0; layer < node->height; ++layer) node->next(layer) = nullptr;
+
+        FingerPath<AfterEqual>(node->val, up, ranks);
+        LinkNode(node, up, ranks);
+        SaveFinger(up, ranks);
+        node = next;
+    }
+    if (!finger_enabled_) finger_.clear();
+}
+
+/*
+ * Builds a new list from the elements only in this list (OnlyThis), only in other (OnlyOther), or in both (Both),
+ * pairing off equal elements one to one like the std set algorithms. Copies keep the height of the tower they come
+ * from and are appended in order, so nothing in the new list is searched.
+ * Both lists are walked together in O(n + m), unless only elements of the smaller list can be kept (Intersect(), and
+ * Difference() of a small list). Then each element of the smaller list is looked up in the larger one by a finger
+ * search from the path to the one before, see PathFrom(), visiting O(m log(n/m)) nodes.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool OnlyThis, bool OnlyOther, bool Both>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Combine(const skip_list& other) const
+{
+    skip_list result(generator_.P(), this->comp(), Allocator(node_traits::select_on_container_copy_construction(allocator_)));
+    skip_list_node<T, LinkPolicy::linked>* tail[max_layers];
+    size_t tail_ranks[max_layers];
+    const auto append = [&](const skip_list_node<T, LinkPolicy::linked>* node)
+    {
+        result.AppendNode(result.CreateNode(node->height, node->val), tail, tail_ranks);
+    };
+
+    const bool this_small = size_ * gallop_ratio < other.size_;
+    const bool other_small = other.size_ * gallop_ratio < size_;
+    if (!OnlyOther && ((!OnlyThis && (this_small || other_small)) || (OnlyThis && this_small)))
+    {
+        const auto& small = this_small ? *this : other;
+        const auto& large = this_small ? other : *this;
+
+        // first element of large not yet paired off, and the path to the last one searched for
+        auto match = large.size_ ? large.layers_.front() : nullptr;
+        skip_list_node<T, LinkPolicy::linked>* path[max_layers];
+        std::fill(path, path + large.layers_.size(), nullptr);
+        for (auto node = small.size_ ? small.layers_.front() : nullptr; node && (match || OnlyThis); node = node->next(0))
+        {
+            if (match && Less(match->val, node->val)) match = large.template PathFrom<false>(node->val, path, nullptr, path, nullptr);
+
+            if (match && !Less(node->val, match->val))
+            {
+                // elements of this list are the ones kept
+                if (Both) append(this_small ? node : match);
+                match = match->next(0);
+            }
+            else if (OnlyThis) append(node);
+        }
+    }
+    else
+    {
+        auto a = size_ ? layers_.front() : nullptr;
+        auto b = other.size_ ? other.layers_.front() : nullptr;
+        while (a && b)
+        {
+            if (Less(a->val, b->val))
+            {
+                if (OnlyThis) append(a);
+                a = a->next(0);
+            }
+            else if (Less(b->val, a->val))
+            {
+                if (OnlyOther) append(b);
+                b = b->next(0);
+            }
             else
             {
-                layers_[layer] = node->next;
-                if (!layers_.back()) layers_.pop_back();
+                if (Both) append(a);
+                a = a->next(0);
+                b = b->next(0);
             }
-        
-            --layer;
-            delete node;
-        } while (current);
+        }
+        for (; OnlyThis && a; a = a->next(0)) append(a);
+        for (; OnlyOther && b; b = b->next(0)) append(b);
+    }
+
+    result.FinishAppend(tail, tail_ranks);
+    return result;
+}
 
-        --size_;
-        return true;
+/*
+ * Cuts the link before key in every layer, the towers after it become the new list as they are. In indexed lists the
+ * widths of the cut links give the position of key, and become the widths of the new list's heads and of this list's
+ * last links. Otherwise the two sides are counted from the cut outwards together, stopping at the end of the shorter.
+ * The new list shares the allocator, pooled lists included since Clear() only releases a pool holding no other list's
+ * nodes.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SplitAt(const K& key)
+{
+    skip_list result(generator_.P(), this->comp(), Allocator(allocator_));
+    if (size_ == 0) return result;
+    finger_.clear();
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    const auto first = FindPath<false>(key, up, ranks);
+    if (!first) return result;
+
+    // position of first in indexed lists, otherwise the number of elements before key
+    size_t before = indexed ? ranks[0] : 0;
+    if constexpr (!indexed)
+    {
+        // walks both sides of the cut together, stopping at the end of the shorter one
+        auto after = first;
+        size_t counted = 0;
+        if constexpr (linked)
+            for (auto back = up[0]; after && back; after = after->next(0), back = back->prev) ++counted;
+        else
+            for (auto back = layers_.front(); after && back != first; after = after->next(0), back = back->next(0)) ++counted;
+        before = after ? counted : size_ - counted;
     }
-    
-    return false;
+
+    for (unsigned layer = 0; layer < layers_.size(); ++layer)
+    {
+        auto& link = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        if constexpr (indexed)
+        {
+            auto& width = Width(up[layer], layer);
+            if (link) result.head_widths_.push_back(ranks[layer] + width - before);
+            width = before + 1 - ranks[layer];
+        }
+        if (!link) continue;
+        result.layers_.push_back(link);
+        link = nullptr;
+    }
+    if constexpr (linked) first->prev = nullptr;
+    result.size_ = size_ - before;
+    size_ = before;
+    DropEmptyLayers();
+
+    // while tracking stats the towers of the shorter side are counted, the longer side keeps the rest of the counts
+    if (track_stats_)
+    {
+        const bool cut_shorter = result.size_ <= size_;
+        result.track_stats_ = true;
+        CountHeights(cut_shorter ? first : size_ ? layers_.front() : nullptr, nullptr, result.heights_);
+        for (size_t h = 0; h < result.heights_.size(); ++h) heights_[h] -= result.heights_[h];
+        if (!cut_shorter) std::swap(heights_, result.heights_);
+    }
+    return result;
+}
+
+/*
+ * The last tower of each layer is found by searching for the first element of other, after equal elements. Links of
+ * other's layers are attached there and this list grows any layers other has more of. In indexed lists the attached
+ * links get the width up to other's first tower in that layer, and links over other in taller layers grow by its size.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Join(skip_list&& other)
+{
+    if (&other == this || other.size_ == 0) return;
+    finger_.clear();
+    other.finger_.clear();
+
+    const bool shared = allocator_ == other.allocator_;
+    if (size_ == 0 && shared)
+    {
+        heights_.clear();
+        CountList(other);
+        other.heights_.clear();
+        std::swap(layers_, other.layers_);
+        std::swap(head_widths_, other.head_widths_);
+        std::swap(size_, other.size_);
+        return;
+    }
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    const auto first = other.layers_.front();
+    FindPath<true>(first->val, up, ranks);
+    assert(size_ == 0 || !Less(first->val, up[0]->val));
+
+    // our allocator can't free other's nodes, append copies instead
+    if (!shared)
+    {
+        try
+        {
+            for (auto node = first; node; node = node->next(0)) AppendNode(CreateNode(node->height, node->val), up, ranks);
+        }
+        catch (...)
+        {
+            FinishAppend(up, ranks);
+            throw;
+        }
+        FinishAppend(up, ranks);
+        other.Clear();
+        return;
+    }
+
+    for (unsigned layer = 0; layer < other.layers_.size(); ++layer)
+    {
+        if (layer == layers_.size())
+        {
+            layers_.push_back(other.layers_[layer]);
+            if constexpr (indexed) head_widths_.push_back(size_ + other.head_widths_[layer]);
+        }
+        else
+        {
+            up[layer]->next(layer) = other.layers_[layer];
+            if constexpr (indexed) up[layer]->width(layer) = size_ - ranks[layer] + other.head_widths_[layer];
+        }
+    }
+    if constexpr (indexed)
+        for (auto layer = static_cast<unsigned>(other.layers_.size()); layer < layers_.size(); ++layer) up[layer]->width(layer) += other.size_;
+
+    if constexpr (linked) first->prev = up[0];
+    CountList(other);
+    size_ += other.size_;
+    other.layers_.clear();
+    other.head_widths_.clear();
+    other.heights_.clear();
+    other.size_ = 0;
+}
+
+/*
+ * Walks the bottom layer of other once, creating a tower of the same height for each node and appending it to the end
+ * of each of its layers, as AssignSorted() does. Nothing is compared or searched, and in indexed lists the widths are
+ * copied as they are. If copying an element throws, the list is left empty.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::CloneFrom(const skip_list& other)
+{
+    assert(size_ == 0);
+    if (other.size_ == 0) return;
+
+    // last node of each layer
+    skip_list_node<T, LinkPolicy::linked>* tail[max_layers];
+
+    try
+    {
+        for (auto source = other.layers_.front(); source; source = source->next(0))
+        {
+            auto node = CreateNode(source->height, source->val);
+            if constexpr (linked) node->prev = size_ ? tail[0] : nullptr;
+
+            for (unsigned layer = 0; layer < node->height; ++layer)
+            {
+                if (layer == layers_.size()) layers_.push_back(node);
+                else tail[layer]->next(layer) = node;
+                tail[layer] = node;
+                if constexpr (indexed) node->width(layer) = source->width(layer);
+            }
+            CountTower(node->height);
+            ++size_;
+        }
+    }
+    catch (...)
+    {
+        Clear();
+        throw;
+    }
+
+    if constexpr (indexed) head_widths_ = other.head_widths_;
 }
 
 /*
  * Removes all elements from the list.
+ * If T needs no destructor and the allocator supports Release() (e.g. skip_list_pool_allocator), the whole arena is
+ * freed at once instead of visiting every node. Every tower is one block, so that is only done when the allocator has
+ * no more blocks in use than this list has elements. Otherwise other containers share the pool, and the nodes are
+ * freed one by one.
  */
-template <typename T>
-void skip_list<T>::Clear()
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Clear()
 {
     if (size_ == 0) return;
-        
-    for (auto node : layers_)
+
+    bool released = false;
+    if constexpr (std::is_trivially_destructible<T>::value && skip_list_releasable<node_allocator>::value)
+    {
+        if (allocator_.BlocksInUse() == size_)
+        {
+            allocator_.Release();
+            released = true;
+        }
+    }
+
+    if (!released)
     {
+        // every tower is linked into the bottom layer
+        auto node = layers_.front();
         while (node)
         {
-            auto next = node->next;
-            delete node;
+            auto next = node->next(0);
+            DestroyNode(node);
             node = next;
         }
     }
-    
+
     layers_.clear();
+    finger_.clear();
+    head_widths_.clear();
+    heights_.clear();
     size_ = 0;
 }
 
@@ -344,22 +1646,22 @@ void skip_list<T>::Clear()
  * Prints the skip_list.
  * Prints all layers if internal_rep is true, otherwise only the lowest layer is displayed.
  */
-template <typename T>
-void skip_list<T>::Print(const bool internal_rep)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Print(const bool internal_rep)
 {
     const int n = internal_rep ? static_cast<int>(layers_.size()) : 1;
 
     if (internal_rep && size_ == 0) std::cout << " Empty" << std::endl;
-    
+
     for (int i = 0; i < n; ++i)
     {
         if (internal_rep) std::cout << " Layer " << i << ":";
-        
-        auto current = layers_[i];
+
+        auto current = layers_.empty() ? nullptr : layers_[i];
         while (current)
         {
             std::cout << " " << current->val;
-            current = current->next;
+            current = current->next(i);
         }
         std::cout << std::endl;
     }
@@ -367,44 +1669,651 @@ void skip_list<T>::Print(const bool internal_rep)
     std::cout << std::endl;
 }
 
+/*
+ * Returns the number of bytes used by all tower nodes plus the layer head vector.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+size_t skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::MemoryUsage() const
+{
+    size_t bytes = layers_.capacity() * sizeof(skip_list_node<T, LinkPolicy::linked>*) + head_widths_.capacity() * sizeof(size_t);
+    for (auto node = layers_.empty() ? nullptr : layers_.front(); node; node = node->next(0))
+        bytes += skip_list_node<T, LinkPolicy::linked>::Bytes(node->height, indexed);
+    return bytes;
+}
+
+/*
+ * Returns the average tower height, i.e. the number of layers each element is linked into.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+double skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::AverageHeight() const
+{
+    if (size_ == 0) return 0;
+
+    size_t links = 0;
+    for (auto node = layers_.front(); node; node = node->next(0)) links += node->height;
+    return static_cast<double>(links) / static_cast<double>(size_);
+}
+
+/*
+ * Takes the tower heights from the counts kept while tracking stats, or from one walk along the bottom layer, and
+ * derives the rest from them: a tower of height h is a node in each of the first h layers.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+skip_list_stats skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Stats() const
+{
+    skip_list_stats stats;
+    stats.size = size_;
+    stats.p = generator_.P();
+    if (track_stats_) stats.height_counts = heights_;
+    else CountHeights(layers_.empty() ? nullptr : layers_.front(), nullptr, stats.height_counts);
+    stats.height_counts.resize(layers_.size());
+
+    stats.layer_nodes.resize(layers_.size());
+    size_t nodes = 0;
+    for (auto layer = layers_.size(); layer-- > 0;)
+    {
+        nodes += stats.height_counts[layer];
+        stats.layer_nodes[layer] = nodes;
+        stats.node_bytes += stats.height_counts[layer] * skip_list_node<T, LinkPolicy::linked>::Bytes(static_cast<unsigned>(layer) + 1, indexed);
+    }
+
+    size_t promoted = 0;
+    size_t promotable = 0;
+    for (size_t layer = 0; layer < layers_.size(); ++layer)
+    {
+        stats.average_gap.push_back(static_cast<double>(size_) / static_cast<double>(stats.layer_nodes[layer]));
+        if (layer + 1 == layers_.size()) break;
+        promotable += stats.layer_nodes[layer];
+        promoted += stats.layer_nodes[layer + 1];
+    }
+    if (promotable) stats.promotion_ratio = static_cast<double>(promoted) / static_cast<double>(promotable);
+
+    stats.layer_bytes = layers_.capacity() * sizeof(skip_list_node<T, LinkPolicy::linked>*) + head_widths_.capacity() * sizeof(size_t);
+    return stats;
+}
+
+/*
+ * Enables or disables counting the towers by height as the list changes, see Stats().
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::TrackStats(const bool enabled)
+{
+    if (enabled == track_stats_) return;
+    track_stats_ = enabled;
+    heights_.clear();
+    if (enabled) CountHeights(layers_.empty() ? nullptr : layers_.front(), nullptr, heights_);
+    else heights_.shrink_to_fit();
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::CountHeights(const skip_list_node<T, LinkPolicy::linked>* node, const skip_list_node<T, LinkPolicy::linked>* end,
+                                                                                             std::vector<size_t>& heights)
+{
+    for (; node != end; node = node->next(0))
+    {
+        if (heights.size() < node->height) heights.resize(node->height);
+        ++heights[node->height - 1];
+    }
+}
+
+/*
+ * Adds other's counts if it keeps them, otherwise walks its towers.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::CountList(const skip_list& other)
+{
+    if (!track_stats_) return;
+    if (!other.track_stats_) return CountHeights(other.size_ ? other.layers_.front() : nullptr, nullptr, heights_);
+
+    if (heights_.size() < other.heights_.size()) heights_.resize(other.heights_.size());
+    for (size_t h = 0; h < other.heights_.size(); ++h) heights_[h] += other.heights_[h];
+}
+
+/*
+ * Lays the file out in memory first: each record's offset is known when it is reached, and is patched into the links
+ * of the last record of each layer it joins, as CloneFrom() links towers. Then the checksums are filled in and the
+ * file is written at once. Widths of indexed lists aren't saved.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Save(const std::string& path) const
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Save() needs a trivially copyable T");
+
+    typedef skip_list_file::node<T> record;
+    struct alignas(record) unit { unsigned char bytes[alignof(record)]; };
+
+    const auto layers = static_cast<std::uint32_t>(layers_.size());
+    const auto nodes_offset = skip_list_file::NodesOffset<T>(layers);
+    auto file_size = nodes_offset;
+    for (auto node = layers ? layers_.front() : nullptr; node; node = node->next(0)) file_size += record::Bytes(node->height);
+
+    std::vector<unit> file(file_size / sizeof(unit));
+    const auto bytes = reinterpret_cast<unsigned char*>(file.data());
+    const auto set_link = [bytes](std::uint64_t at, std::uint64_t offset) { std::memcpy(bytes + at, &offset, sizeof(offset)); };
+
+    // position of the link to patch in each layer, starting with the layer heads
+    std::uint64_t tail[max_layers];
+    for (std::uint32_t layer = 0; layer < layers; ++layer) tail[layer] = sizeof(skip_list_file::header) + layer * sizeof(std::uint64_t);
+
+    auto offset = nodes_offset;
+    for (auto node = layers ? layers_.front() : nullptr; node; node = node->next(0))
+    {
+        new (bytes + offset) record{ node->val, node->height };
+        for (unsigned layer = 0; layer < node->height; ++layer)
+        {
+            set_link(tail[layer], offset);
+            tail[layer] = offset + sizeof(record) + layer * sizeof(std::uint64_t);
+        }
+        offset += record::Bytes(node->height);
+    }
+
+    skip_list_file::header header{};
+    std::memcpy(header.magic, skip_list_file::magic, sizeof(header.magic));
+    header.version = skip_list_file::format_version;
+    header.byte_order = skip_list_file::byte_order;
+    header.value_size = sizeof(T);
+    header.value_align = alignof(T);
+    header.layers = layers;
+    header.size = size_;
+    header.file_size = file_size;
+    header.body_checksum = skip_list_file::Checksum(bytes + sizeof(header), file_size - sizeof(header));
+    header.header_checksum = skip_list_file::HeaderChecksum(header);
+    std::memcpy(bytes, &header, sizeof(header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(file_size));
+    out.close();
+    if (!out) throw std::runtime_error("skip_list::Save() couldn't write " + path);
+}
+
 /*
  * Finds and returns the first node matching val in any layer, searching from highest layer.
- * layer will contain the layer of a returned node
  * returns null if val is not in the list
  */
-template <typename T>
-skip_list_node<T>* skip_list<T>::Find(T val, int& layer)
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::FindNode(const K& val) const
 {
-    // is list empty
-    if (size_ == 0) return nullptr;
-    
-    // start at highest layer
-    layer = static_cast<int>(layers_.size()) - 1;
-    skip_list_node<T>* current = layers_[layer];
-    
-    // move down start of layers if val is smaller than first in layer
-    while (layer > 0 && val < current->val)
-        current = layers_[--layer];
-    
-    // smaller than min, not in list
-    if (val < current->val) return nullptr;
+    if (finger_enabled_)
+    {
+        auto node = Locate<false>(val);
+        return node && !Less(val, node->val) ? node : nullptr;
+    }
+    if (tuning_.enabled) Observe(val, false);
+
+    skip_list_node<T, LinkPolicy::linked>* current = nullptr;
 
     // search through each layer until we find the value
-    while (current)
+    for (auto layer = layers_.size(); layer-- > 0;)
     {
-        // search current layer while value is less or equal current
-        while (current->next && Less_Or_Equal(current->next->val, val)) current = current->next;
-
-        // first condition indicates val and current->val are equal after previous loop
-        if (!(current->val < val) || !current->down) break;
+        // search current layer while value is less than val
+        auto next = current ? current->next(layer) : layers_[layer];
+        while (next && Less(next->val, val))
+        {
+            current = next;
+            next = next->next(layer);
+        }
 
-        // continue down a layer
-        current = current->down;
-        --layer;
+        // next is the first node not less than val in this layer, stop if it matches
+        if (next && !Less(val, next->val)) return next;
     }
-    
-    // will have found it by now if it exists
-    if (Equal(current->val, val)) return current;
-    
+
     return nullptr;
 }
+
+/*
+ * Caches the last node before val in each layer in up, nullptr means the start of the layer. up may be null when only
+ * the position is needed. The position is before any elements equal to val, or after them if AfterEqual.
+ * The search starts at current (nullptr for the layer heads) in layer layers - 1, current must come before val.
+ * In indexed lists the position of each node in up is kept in ranks (if not null), counting from rank, the position of
+ * current.
+ * Returns the node following the position in the bottom layer (the lower or upper bound), or null at the end of the list.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool AfterEqual, typename K>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SearchDown(skip_list_node<T, LinkPolicy::linked>* current, unsigned layers,
+                                                                                                                             const K& val, skip_list_node<T, LinkPolicy::linked>** up,
+                                                                                                                             size_t* ranks, size_t rank) const
+{
+    skip_list_node<T, LinkPolicy::linked>* next = nullptr;
+
+    for (auto layer = layers; layer-- > 0;)
+    {
+        // search current layer while value is less (or equal) to val
+        next = current ? current->next(layer) : layers_[layer];
+        while (next && Before<AfterEqual>(next, val))
+        {
+            if constexpr (indexed) rank += Width(current, layer);
+            current = next;
+            next = next->next(layer);
+        }
+        if (up) up[layer] = current;
+        if constexpr (indexed) if (ranks) ranks[layer] = rank;
+    }
+
+    return next;
+}
+
+/*
+ * Finger search from a saved path, such as the path of the last operation (Pugh, "A Skip List Cookbook"). Climbs the
+ * path until its node is still the last one before val in that layer, then searches down from there. Higher layers of
+ * the path are unchanged, so a key at distance d from the last one costs O(log d) in either direction.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool AfterEqual, typename K>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::PathFrom(const K& val, skip_list_node<T, LinkPolicy::linked>* const* from,
+                                                                                                                           const size_t* from_ranks,
+                                                                                                                           skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks) const
+{
+    const auto layers = static_cast<unsigned>(layers_.size());
+
+    unsigned top = 0;
+    for (; top + 1 < layers; ++top)
+    {
+        const auto prev = from[top];
+        const auto next = prev ? prev->next(top) : layers_[top];
+        if ((!prev || Before<AfterEqual>(prev, val)) && (!next || !Before<AfterEqual>(next, val))) break;
+    }
+    if (from != up) std::copy(from + top + 1, from + layers, up + top + 1);
+    if constexpr (indexed) if (ranks && from_ranks != ranks) std::copy(from_ranks + top + 1, from_ranks + layers, ranks + top + 1);
+
+    // on the top layer the path may still be after val, then that layer is searched from its start
+    const auto start = from[top] && Before<AfterEqual>(from[top], val) ? from[top] : nullptr;
+    const size_t rank = indexed && ranks && start ? from_ranks[top] : 0;
+    return SearchDown<AfterEqual>(start, top + 1, val, up, ranks, rank);
+}
+
+/*
+ * Returns the node after the position of val in the bottom layer. With a finger the search starts from the last
+ * finger and leaves it at val, otherwise it starts from the top without keeping a path.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool AfterEqual, typename K>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Locate(const K& val) const
+{
+    if (tuning_.enabled) Observe(val, false);
+    if (!finger_enabled_) return FindPath<AfterEqual>(val, nullptr);
+
+    skip_list_node<T, LinkPolicy::linked>* up[max_layers];
+    size_t ranks[max_layers];
+    auto node = FingerPath<AfterEqual>(val, up, ranks);
+    SaveFinger(up, ranks);
+    return node;
+}
+
+/*
+ * Finger search from a single node. Moves forward along the top layer of the current tower while that skips ahead of
+ * nothing past val, stepping onto taller towers as they come up, then searches down from the last tower reached.
+ * Only the layers of that tower are known afterwards, so if it is shorter than height (or hint is null or after val)
+ * the search starts from the top instead.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <bool AfterEqual, typename K>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::HintPath(skip_list_node<T, LinkPolicy::linked>* hint, const K& val,
+                                                                                                                           skip_list_node<T, LinkPolicy::linked>** up, size_t* ranks,
+                                                                                                                           unsigned height) const
+{
+    // a path from hint doesn't give absolute positions, which linking into an indexed list needs
+    if (hint && Before<AfterEqual>(hint, val) && !(indexed && up))
+    {
+        auto current = hint;
+        for (auto next = current->next(current->height - 1); next && Before<AfterEqual>(next, val);
+             next = current->next(current->height - 1))
+            current = next;
+
+        if (current->height >= height) return SearchDown<AfterEqual>(current, current->height, val, up, nullptr, 0);
+    }
+
+    if (up) return SearchPath<AfterEqual>(val, up, ranks);
+    return Locate<AfterEqual>(val);
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename RandomIt, typename OutputIt>
+OutputIt skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::ContainsBatch(RandomIt first, RandomIt last, OutputIt out) const
+{
+    const auto count = static_cast<size_t>(last - first);
+    SearchBatch(first, count, [&](size_t i, const skip_list_node<T, LinkPolicy::linked>* node) { out[i] = node && !Less(first[i], node->val); });
+    return out + count;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename RandomIt, typename OutputIt>
+OutputIt skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::FindBatch(RandomIt first, RandomIt last, OutputIt out) const
+{
+    const auto count = static_cast<size_t>(last - first);
+    SearchBatch(first, count, [&](size_t i, skip_list_node<T, LinkPolicy::linked>* node) { out[i] = iterator(node && !Less(first[i], node->val) ? node : nullptr, this); });
+    return out + count;
+}
+
+/*
+ * Each search down the list is a chain of dependent cache misses, one per node visited. Instead of following one chain
+ * to the end, batch_group searches are kept in flight as small state machines (the last node before the key and the
+ * current layer). A step compares the key with the next node of its search, which was prefetched when the previous
+ * step chose it, picks the following node, prefetches it, and moves on to the next search. By the time a search comes
+ * around again its node has usually arrived, so the misses of all the searches in the group overlap. A finished search
+ * is replaced by the next key. The last finger is not used or moved.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename RandomIt, typename Done>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SearchBatch(RandomIt first, size_t count, Done&& done) const
+{
+    if (layers_.empty())
+    {
+        for (size_t i = 0; i < count; ++i) done(i, nullptr);
+        return;
+    }
+
+    struct search
+    {
+        size_t index;                   // position of the key in the batch
+        skip_list_node<T, LinkPolicy::linked>* current;     // last node before the key in layer, null for the start of the layer
+        skip_list_node<T, LinkPolicy::linked>* next;        // node after current in layer, prefetched
+        unsigned layer;
+    };
+
+    search searches[batch_group];
+    unsigned active = 0;
+    size_t started = 0;
+
+    const auto start = [&](search& s)
+    {
+        s.index = started++;
+        s.current = nullptr;
+        s.layer = static_cast<unsigned>(layers_.size()) - 1;
+        s.next = layers_[s.layer];
+        Prefetch(s.next);
+    };
+
+    while (active < batch_group && started < count) start(searches[active++]);
+
+    while (active)
+    {
+        for (unsigned i = 0; i < active;)
+        {
+            auto& s = searches[i];
+
+            if (s.next && Less(s.next->val, first[s.index])) s.current = s.next;
+            else if (s.layer > 0) --s.layer;
+            else
+            {
+                // search finished, start the next key in its place or close the gap
+                done(s.index, s.next);
+                if (started < count)
+                {
+                    start(s);
+                    ++i;
+                }
+                else s = searches[--active];
+                continue;
+            }
+
+            s.next = s.current ? s.current->next(s.layer) : layers_[s.layer];
+            Prefetch(s.next);
+            ++i;
+        }
+    }
+}
+
+/*
+ * Enables or disables starting each search from the last finger.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::UseFinger(const bool enabled)
+{
+    finger_enabled_ = enabled;
+    finger_.clear();
+    if (enabled) finger_.reserve(max_layers);
+    else finger_.shrink_to_fit();
+}
+
+/*
+ * Returns an element equal to val found by searching forward from hint.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+typename skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::iterator
+skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Find(iterator hint, const T& val) const
+{
+    if (hint.node_ && Equal(hint.node_->val, val)) return hint;
+    auto node = HintPath<false>(hint.node_, val, nullptr, nullptr, 1);
+    return iterator(node && !Less(val, node->val) ? node : nullptr, this);
+}
+
+/*
+ * Links a new tower into each of its layers after the nodes cached in up by FindPath(), adding new top layers if the
+ * tower is taller than the list.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::LinkNode(skip_list_node<T, LinkPolicy::linked>* node, skip_list_node<T, LinkPolicy::linked>** up,
+                                                                                         size_t* ranks)
+{
+    // position of the new node in indexed lists, the path is empty if the list is
+    const size_t rank = indexed && !layers_.empty() ? ranks[0] + 1 : 1;
+
+    for (unsigned layer = 0; layer < node->height; ++layer)
+    {
+        // add to new higher layer if needed
+        if (layer == layers_.size())
+        {
+            layers_.push_back(node);
+            up[layer] = nullptr;
+            if constexpr (indexed)
+            {
+                ranks[layer] = 0;
+                head_widths_.push_back(rank);
+                node->width(layer) = size_ + 2 - rank;
+            }
+            continue;
+        }
+
+        // add after cached node, or to start of layer
+        auto& link = up[layer] ? up[layer]->next(layer) : layers_[layer];
+        node->next(layer) = link;
+        link = node;
+
+        // split the width of the link the node was inserted into
+        if constexpr (indexed)
+        {
+            auto& width = Width(up[layer], layer);
+            node->width(layer) = width + 1 - (rank - ranks[layer]);
+            width = rank - ranks[layer];
+        }
+    }
+
+    // links over the node in higher layers skip one more element
+    if constexpr (indexed)
+        for (auto layer = node->height; layer < layers_.size(); ++layer) ++Width(up[layer], layer);
+
+    // fix neighboring links in bottom layer
+    if constexpr (linked)
+    {
+        node->prev = layers_.front() == node ? nullptr : up[0];
+        if (node->next(0)) node->next(0)->prev = node;
+    }
+    CountTower(node->height);
+    ++size_;
+}
+
+/*
+ * Returns a random height for a new tower, capped by MaxHeight() for the size the list will have after insertion.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+unsigned skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::RandomHeight()
+{
+    return generator_(MaxHeight(size_ + 1));
+}
+
+/*
+ * Returns the tallest tower allowed in a list of size elements, the height cap if one is set. Otherwise it is
+ * floor(log_1/p(size)) + 1, the number of layers that leaves fewer than 1/p towers expected to reach the top one, so
+ * searches take about 1/p steps in every layer (floor(ln(size)) + 1 if p is 0 or 1). At most max_layers.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+unsigned skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::MaxHeight(size_t size) const
+{
+    if (height_cap_) return height_cap_;
+    if (size == 0) return 1;
+
+    // the small margin keeps exact powers of 1/p from rounding down
+    const auto p = static_cast<double>(generator_.P());
+    const auto base = p > 0 && p < 1 ? std::log(1 / p) : 1.0;
+    return std::min(static_cast<unsigned>(std::log(static_cast<double>(size)) / base + 1e-9) + 1, max_layers);
+}
+
+/*
+ * Sets the height cap for new towers, 0 to follow the size of the list.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::SetHeightCap(const unsigned height)
+{
+    assert(height <= max_layers);
+    height_cap_ = std::min(height, max_layers);
+}
+
+/*
+ * Enables or disables tuning p, starting the observations over.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::AutoTune(const bool enabled, const skip_list_tuning& tuning)
+{
+    static_assert(skip_list_tunable<LevelGenerator>::value, "AutoTune() needs a LevelGenerator with SetP()");
+    assert(tuning.min_p > 0 && tuning.min_p <= tuning.max_p && tuning.max_p < 1 && tuning.window > 0 && tuning.sample > 0);
+
+    tuning_ = tuning_state();
+    tuning_.bounds = tuning;
+    tuning_.enabled = enabled;
+}
+
+/*
+ * Builds the layers anew in a list with a fresh allocator, as AssignSorted() does, then takes over its structure and
+ * allocator. The old towers are freed one by one, releasing their allocator at once could free another list's nodes.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::RebuildLayers()
+{
+    tuning_.since_change = 0;
+    if (size_ == 0) return;
+
+    skip_list rebuilt(generator_.P(), this->comp(), Allocator(node_traits::select_on_container_copy_construction(allocator_)));
+    rebuilt.height_cap_ = height_cap_;
+    rebuilt.AssignSorted(begin(), end());
+
+    std::swap(layers_, rebuilt.layers_);
+    std::swap(head_widths_, rebuilt.head_widths_);
+    std::swap(allocator_, rebuilt.allocator_);
+    finger_.clear();
+    if (track_stats_)
+    {
+        heights_.clear();
+        CountHeights(layers_.front(), nullptr, heights_);
+    }
+
+    for (auto node = rebuilt.layers_.front(); node;)
+    {
+        const auto next = node->next(0);
+        rebuilt.DestroyNode(node);
+        node = next;
+    }
+    rebuilt.layers_.clear();
+    rebuilt.head_widths_.clear();
+    rebuilt.size_ = 0;
+}
+
+/*
+ * Counts the operation, and for one in every tuning.sample operations searches for val from the top again, counting
+ * each node compared with it.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename K>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Observe(const K& val, const bool write) const
+{
+    ++(write ? tuning_.writes : tuning_.reads);
+    if ((tuning_.reads + tuning_.writes) % tuning_.bounds.sample) return;
+
+    size_t hops = 0;
+    skip_list_node<T, LinkPolicy::linked>* current = nullptr;
+    for (auto layer = layers_.size(); layer-- > 0;)
+    {
+        auto next = current ? current->next(layer) : layers_[layer];
+        for (; next && Less(next->val, val); next = next->next(layer), ++hops) current = next;
+        if (next) ++hops;
+    }
+    tuning_.hops += hops;
+    ++tuning_.sampled;
+}
+
+/*
+ * Sets p between tuning.min_p and tuning.max_p, geometrically by the share of reads in the last window, ignoring changes
+ * of less than an eighth so a steady mix doesn't keep moving it. New towers get heights for the new p and the layers
+ * drift toward it as elements come and go. The layers are only rebuilt if the measured searches are a quarter longer
+ * than p should give for the size of the list, or there are two layers fewer than the height cap allows (lists built
+ * under a lower cap or a smaller p), and not before there have been as many operations as elements since
+ * p last changed, so a rebuild costs O(1) per operation.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+bool skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::Tune()
+{
+    const auto operations = tuning_.reads + tuning_.writes;
+    if (operations < tuning_.bounds.window) return false;
+
+    const auto reads = static_cast<double>(tuning_.reads) / static_cast<double>(operations);
+    const auto bounds = tuning_.bounds;
+    const auto target = static_cast<float>(bounds.min_p * std::pow(static_cast<double>(bounds.max_p) / bounds.min_p, reads));
+    const auto p = generator_.P();
+    if constexpr (skip_list_tunable<LevelGenerator>::value)
+    {
+        if (std::abs(target - p) > p / 8)
+        {
+            generator_.SetP(target);
+            tuning_.since_change = 0;
+        }
+    }
+    tuning_.since_change += operations;
+
+    const bool stale = layers_.size() + 2 < MaxHeight(size_) ||
+        (tuning_.sampled && static_cast<double>(tuning_.hops) / static_cast<double>(tuning_.sampled) > 1.25 * ExpectedHops(size_, generator_.P()));
+    const bool rebuild = stale && tuning_.since_change >= size_;
+    tuning_.reads = 0;
+    tuning_.writes = 0;
+    tuning_.sampled = 0;
+    tuning_.hops = 0;
+    if (rebuild) RebuildLayers();
+    return rebuild;
+}
+
+/*
+ * A search takes about 1/p steps in each of the log_1/p(n) layers (Pugh, "Skip Lists: A Probabilistic Alternative to
+ * Balanced Trees"), plus the nodes it stops at.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+double skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::ExpectedHops(const size_t size, const float p)
+{
+    if (size < 2 || p <= 0 || p >= 1) return 1;
+    const auto layers = std::log(static_cast<double>(size)) / std::log(1 / static_cast<double>(p));
+    return layers / p + 1 / (1 - static_cast<double>(p));
+}
+
+/*
+ * Allocates storage for a tower node with room for height links from the allocator and constructs the node in it,
+ * forwarding args to the constructor of its value.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+template <typename... Args>
+skip_list_node<T, LinkPolicy::linked>* skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::CreateNode(unsigned height, Args&&... args)
+{
+    const auto units = NodeUnits(height);
+    auto memory = node_traits::allocate(allocator_, units);
+    try { return new (static_cast<void*>(memory)) skip_list_node<T, LinkPolicy::linked>(height, std::forward<Args>(args)...); }
+    catch (...) { node_traits::deallocate(allocator_, memory, units); throw; }
+}
+
+/*
+ * Destroys a node created with CreateNode() and returns its storage to the allocator.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator, typename IndexPolicy, typename LinkPolicy>
+void skip_list<T, Compare, Allocator, LevelGenerator, IndexPolicy, LinkPolicy>::DestroyNode(skip_list_node<T, LinkPolicy::linked>* node)
+{
+    const auto units = NodeUnits(node->height);
+    node->~skip_list_node();
+    node_traits::deallocate(allocator_, reinterpret_cast<node_storage*>(node), units);
+}
@@ -0,0 +1,209 @@
+/*
+ * Epoch based memory reclamation for the concurrent skip lists.
+ *
+ * Threads pin the current global epoch while they hold pointers into a shared structure. A node removed from the
+ * structure is retired, tagged with the global epoch at that time, instead of being freed. The global epoch only moves
+ * on once every pinned thread has seen it, so after it has moved on twice no thread can still hold a pointer to the
+ * node and it is handed to the reclaim function.
+ *
+ * Pinning is one store and one load of per thread state. Each thread keeps its retired nodes in three lists, one per
+ * epoch modulo 3, so reclaiming needs no synchronization.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+class skip_list_epoch
+{
+public:
+    // called with the context given to the constructor for every retired object once it is safe to free
+    using reclaim_function = void (*)(void* context, void* object);
+
+    // Constructor
+    skip_list_epoch(reclaim_function reclaim, void* context)
+        : reclaim_(reclaim), context_(context), global_(0), records_(nullptr), id_(NextId()) {}
+
+    skip_list_epoch(const skip_list_epoch&) = delete;
+    skip_list_epoch& operator=(const skip_list_epoch&) = delete;
+
+    // Destructor, reclaims everything still retired. No thread may be pinned
+    ~skip_list_epoch();
+
+    /* pins the calling thread for its lifetime, guards on the same thread nest */
+    class guard
+    {
+    public:
+        guard() : epoch_(nullptr) {}   // pins nothing
+        explicit guard(skip_list_epoch& epoch) : epoch_(&epoch) { epoch_->Enter(); }
+        guard(const guard& other) : epoch_(other.epoch_) { if (epoch_) epoch_->Enter(); }
+        guard(guard&& other) noexcept : epoch_(other.epoch_) { other.epoch_ = nullptr; }
+        guard& operator=(guard other) noexcept { std::swap(epoch_, other.epoch_); return *this; }
+        ~guard() { if (epoch_) epoch_->Exit(); }
+
+    private:
+        skip_list_epoch* epoch_;
+    };
+
+    // pins the calling thread until the returned guard is destroyed
+    guard Pin() { return guard(*this); }
+
+    // hands object to the reclaim function once no pinned thread can hold it. The caller must be pinned and object
+    // must already be unreachable for threads pinning from now on
+    void Retire(void* object);
+
+private:
+    static constexpr unsigned advance_interval = 32;   // retires between attempts to advance the global epoch
+
+    struct limbo
+    {
+        std::uint64_t epoch = 0;
+        std::vector<void*> objects;
+    };
+
+    /* per thread state, owned by the domain and never freed before it */
+    struct record
+    {
+        std::atomic<std::uint64_t> state{ 0 };   // pinned epoch << 1 | 1, or 0 when not pinned
+        unsigned nesting = 0;
+        unsigned retired = 0;
+        limbo lists[3];
+        std::thread::id owner;   // thread using the record, set before it's published. Reused by a later thread with the same id
+        record* next = nullptr;
+    };
+
+    reclaim_function reclaim_;
+    void* context_;
+    std::atomic<std::uint64_t> global_;
+    std::atomic<record*> records_;
+    const std::uint64_t id_;   // identifies the domain in thread local caches, unlike its address ids aren't reused
+
+    static constexpr unsigned cache_size = 4;   // domains each thread remembers its record in
+
+    static std::uint64_t NextId()
+    {
+        static std::atomic<std::uint64_t> next(1);
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // returns the record of the calling thread, registering one the first time
+    record& Local();
+
+    // returns the record owned by the calling thread, or nullptr
+    record* Find(std::thread::id owner) const;
+
+    void Enter();
+    void Exit();
+
+    // moves the global epoch on if every pinned thread has seen it
+    void TryAdvance();
+
+    // reclaims every object in list
+    void Reclaim(limbo& list);
+};
+
+inline skip_list_epoch::~skip_list_epoch()
+{
+    auto r = records_.load(std::memory_order_acquire);
+    while (r)
+    {
+        for (auto& list : r->lists) Reclaim(list);
+        const auto next = r->next;
+        delete r;
+        r = next;
+    }
+}
+
+/*
+ * Records live in the domain, so thread local state is a few (id, record) pairs however many domains a thread uses.
+ * Entries of destroyed domains are never matched, as ids aren't reused, and are overwritten in turn. On a miss the
+ * thread finds its record by owner, and a thread reusing the id of one that exited takes over its unpinned record.
+ */
+inline skip_list_epoch::record& skip_list_epoch::Local()
+{
+    thread_local std::pair<std::uint64_t, record*> cache[cache_size] = {};
+    thread_local unsigned evict = 0;
+    for (const auto& entry : cache)
+        if (entry.first == id_) return *entry.second;
+
+    const auto owner = std::this_thread::get_id();
+    auto r = Find(owner);
+    if (!r)
+    {
+        r = new record;
+        r->owner = owner;
+        r->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+    cache[evict++ % cache_size] = { id_, r };
+    return *r;
+}
+
+inline skip_list_epoch::record* skip_list_epoch::Find(const std::thread::id owner) const
+{
+    for (auto r = records_.load(std::memory_order_acquire); r; r = r->next)
+        if (r->owner == owner) return r;
+    return nullptr;
+}
+
+inline void skip_list_epoch::Enter()
+{
+    auto& r = Local();
+    if (r.nesting++ > 0) return;
+
+    // announce the epoch before reading any shared pointer (seq_cst orders the store before later loads)
+    const auto epoch = global_.load(std::memory_order_seq_cst);
+    r.state.store(epoch << 1 | 1, std::memory_order_seq_cst);
+
+    // anything retired two epochs ago can no longer be held by anyone
+    for (auto& list : r.lists)
+        if (!list.objects.empty() && list.epoch + 2 <= epoch) Reclaim(list);
+}
+
+inline void skip_list_epoch::Exit()
+{
+    auto& r = Local();
+    if (--r.nesting == 0) r.state.store(0, std::memory_order_release);
+}
+
+inline void skip_list_epoch::Retire(void* object)
+{
+    auto& r = Local();
+
+    // tag with the global epoch, which is at least the epoch of any thread that could have seen object
+    const auto epoch = global_.load(std::memory_order_seq_cst);
+    auto& list = r.lists[epoch % 3];
+    if (list.epoch != epoch)
+    {
+        // the list holds objects from epoch - 3 or earlier
+        Reclaim(list);
+        list.epoch = epoch;
+    }
+    list.objects.push_back(object);
+
+    if (++r.retired % advance_interval == 0) TryAdvance();
+}
+
+inline void skip_list_epoch::TryAdvance()
+{
+    auto epoch = global_.load(std::memory_order_seq_cst);
+    for (auto r = records_.load(std::memory_order_acquire); r; r = r->next)
+    {
+        const auto state = r->state.load(std::memory_order_seq_cst);
+        if ((state & 1) && (state >> 1) != epoch) return;
+    }
+    global_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+inline void skip_list_epoch::Reclaim(limbo& list)
+{
+    for (const auto object : list.objects) reclaim_(context_, object);
+    list.objects.clear();
+}
@@ -0,0 +1,119 @@
+/*
+ * On-disk format written by skip_list::Save() and served by mapped_skip_list.
+ *
+ * A file is a header, the offsets of the first node of each layer, then one record per element in order. A record is
+ * the element's bytes followed by its height and one link per layer, and links are byte offsets from the start of the
+ * file instead of pointers (0 ends a layer, no record starts there), so the file can be used wherever it is mapped.
+ * Records are padded to the alignment of the element and the links, so a mapped record can be read in place.
+ *
+ * The header records the format version, the byte order, and the size and alignment of the element type, and carries
+ * a checksum of itself and one of everything after it.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace skip_list_file
+{
+    constexpr char magic[8] = { 'S', 'K', 'I', 'P', 'L', 'I', 'S', 'T' };
+    constexpr std::uint32_t format_version = 1;
+    constexpr std::uint32_t byte_order = 0x01020304;
+
+    // enough layers for any list, skip_list never grows past 64
+    constexpr std::uint32_t max_layers = 64;
+
+    struct header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t value_size;       // sizeof(T)
+        std::uint32_t value_align;      // alignof(T)
+        std::uint32_t layers;           // number of layer heads after the header
+        std::uint32_t reserved;
+        std::uint64_t size;             // number of elements
+        std::uint64_t file_size;
+        std::uint64_t body_checksum;    // checksum of every byte after the header
+        std::uint64_t header_checksum;  // checksum of the header with this field 0
+    };
+
+    /*
+     * Record of one element, followed by height links. Aligned for both T and the links.
+     */
+    template <typename T>
+    struct alignas(std::max(alignof(T), alignof(std::uint64_t))) node
+    {
+        T val;
+        std::uint32_t height;
+
+        std::uint64_t next(unsigned layer) const
+        {
+            std::uint64_t link;
+            std::memcpy(&link, reinterpret_cast<const unsigned char*>(this + 1) + layer * sizeof(link), sizeof(link));
+            return link;
+        }
+
+        // number of bytes of a record with height links, keeping the next record aligned
+        static constexpr std::uint64_t Bytes(unsigned height)
+        {
+            return (sizeof(node) + height * sizeof(std::uint64_t) + alignof(node) - 1) / alignof(node) * alignof(node);
+        }
+    };
+
+    // offset of the first record, after the header and layers heads
+    template <typename T>
+    constexpr std::uint64_t NodesOffset(std::uint32_t layers)
+    {
+        return (sizeof(header) + layers * sizeof(std::uint64_t) + alignof(node<T>) - 1) / alignof(node<T>) * alignof(node<T>);
+    }
+
+    /*
+     * 64-bit checksum (FNV-1a over 8 byte words, then any remaining bytes).
+     */
+    inline std::uint64_t Checksum(const void* data, std::size_t bytes, std::uint64_t hash = 0xcbf29ce484222325ull)
+    {
+        constexpr std::uint64_t prime = 0x100000001b3ull;
+        auto p = static_cast<const unsigned char*>(data);
+        for (; bytes >= sizeof(std::uint64_t); bytes -= sizeof(std::uint64_t), p += sizeof(std::uint64_t))
+        {
+            std::uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        for (; bytes; --bytes, ++p) hash = (hash ^ *p) * prime;
+        return hash;
+    }
+
+    // checksum of h as stored, its header_checksum field counted as 0
+    inline std::uint64_t HeaderChecksum(header h)
+    {
+        h.header_checksum = 0;
+        return Checksum(&h, sizeof(h));
+    }
+
+    /*
+     * Checks that a file of file_size bytes starting with h holds elements of type T, throws std::runtime_error if not.
+     * The body is only checked by its checksum, see mapped_skip_list::Verify().
+     */
+    template <typename T>
+    void CheckHeader(const header& h, std::uint64_t file_size, const std::string& path)
+    {
+        const auto fail = [&](const char* why) { throw std::runtime_error("skip list file " + path + ": " + why); };
+
+        if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) fail("not a skip list file");
+        if (h.header_checksum != HeaderChecksum(h)) fail("header checksum mismatch");
+        if (h.version != format_version) fail("unsupported format version");
+        if (h.byte_order != byte_order) fail("written with a different byte order");
+        if (h.value_size != sizeof(T) || h.value_align != alignof(T)) fail("element type doesn't match");
+        if (h.layers > max_layers || h.file_size != file_size || h.file_size < NodesOffset<T>(h.layers)) fail("truncated or corrupt");
+    }
+}
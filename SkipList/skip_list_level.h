@@ -0,0 +1,139 @@
+/*
+ * Level generation for skip lists.
+ *
+ * skip_list_random is a small per instance xoshiro256** generator seeded through splitmix64, so level choices need no
+ * global state and can be reproduced from a seed.
+ *
+ * skip_list_level_generator draws tower heights from a geometric distribution with promotion probability p. When p is
+ * 1/2^k the whole height comes from a single 64 bit draw by counting trailing zero bits, otherwise each extra layer
+ * costs one integer compare against p scaled to 64 bits.
+ *
+ * Any type with the same interface (constructible from p and a seed, operator()(max_height) returning a height in
+ * [1, max_height], and P()) can be used as the LevelGenerator parameter of skip_list. skip_list::AutoTune() also needs
+ * SetP() to change p as the list runs.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+
+/* xoshiro256** pseudo random generator, https://prng.di.unimi.it/ */
+class skip_list_random
+{
+public:
+    using result_type = std::uint64_t;
+
+    // Constructor. Expands seed into the generator state with splitmix64
+    explicit skip_list_random(std::uint64_t seed)
+    {
+        for (auto& s : state_) s = SplitMix64(seed);
+    }
+
+    // returns the next 64 random bits
+    std::uint64_t operator()()
+    {
+        const auto result = Rotl(state_[1] * 5, 7) * 9;
+        const auto t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = Rotl(state_[3], 45);
+        return result;
+    }
+
+    static constexpr std::uint64_t min() { return 0; }
+    static constexpr std::uint64_t max() { return ~std::uint64_t(0); }
+
+    // returns a seed from std::random_device for generators that don't need to be reproducible
+    static std::uint64_t RandomSeed()
+    {
+        std::random_device rd;
+        return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+    }
+
+private:
+    std::uint64_t state_[4];
+
+    static std::uint64_t Rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    static std::uint64_t SplitMix64(std::uint64_t& x)
+    {
+        auto z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+
+/* Geometric tower height generator with promotion probability p (must be in range [0,1]) */
+class skip_list_level_generator
+{
+public:
+    // Constructor
+    explicit skip_list_level_generator(float p = 0.5, std::uint64_t seed = skip_list_random::RandomSeed()) : random_(seed)
+    {
+        SetP(p);
+    }
+
+    // changes the promotion probability for the heights drawn from now on, keeping the random sequence
+    void SetP(float p)
+    {
+        assert(p >= 0 && p <= 1);
+        p_ = p;
+        shift_ = 0;
+        threshold_ = 0;
+
+        // p == 1/2^k, a layer is added for every k trailing zero bits
+        int exponent;
+        if (p > 0 && std::frexp(p, &exponent) == 0.5f && exponent <= 0) shift_ = 1 - exponent;
+
+        // otherwise promote while a draw is below p * 2^64
+        else if (p < 1) threshold_ = static_cast<std::uint64_t>(std::ldexp(static_cast<double>(p), 64));
+    }
+
+    // returns a random height in [1, max_height]
+    unsigned operator()(unsigned max_height)
+    {
+        unsigned height = 1;
+
+        if (shift_)
+        {
+            height += TrailingZeros(random_()) / shift_;
+        }
+        else if (p_ >= 1) height = max_height;
+        else while (height < max_height && random_() < threshold_) ++height;
+
+        return height < max_height ? height : max_height;
+    }
+
+    // returns the promotion probability
+    float P() const { return p_; }
+
+private:
+    skip_list_random random_;
+    float p_;
+    unsigned shift_;            // k when p == 1/2^k, 0 otherwise
+    std::uint64_t threshold_;   // p scaled to 64 bits
+
+    // number of trailing zero bits in x (64 if x is 0)
+    static unsigned TrailingZeros(std::uint64_t x)
+    {
+        if (!x) return 64;
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+        unsigned n = 0;
+        while (!(x & 1)) { x >>= 1; ++n; }
+        return n;
+#endif
+    }
+};
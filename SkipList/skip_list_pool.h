@@ -0,0 +1,232 @@
+/*
+ * Slab/arena node pool and allocator for skip_list.
+ *
+ * skip_list_pool hands out blocks carved from large slabs with a bump pointer. Freed blocks are kept in a free list per
+ * size class (16 byte granularity) so towers of the same height reuse each other's memory. Slabs can optionally be
+ * backed by huge pages, and Release() returns every slab at once.
+ *
+ * skip_list_pool_allocator wraps a shared pool to satisfy the standard Allocator requirements, and can be passed as the
+ * Allocator parameter of skip_list.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+
+/*
+ * Arena of slabs with per size class free lists. Not thread safe.
+ */
+class skip_list_pool
+{
+public:
+    // Constructor. slab_bytes is the size of each slab requested from the system, huge_pages backs slabs with 2MB pages
+    explicit skip_list_pool(bool huge_pages = false, size_t slab_bytes = 64 * 1024)
+        : huge_pages_(huge_pages), slab_bytes_(huge_pages ? round_up(slab_bytes, huge_page_bytes) : slab_bytes),
+          cursor_(nullptr), end_(nullptr), bytes_in_use_(0), blocks_in_use_(0) {}
+
+    skip_list_pool(const skip_list_pool&) = delete;
+    skip_list_pool& operator=(const skip_list_pool&) = delete;
+
+    // Destructor
+    ~skip_list_pool() { Release(); }
+
+    // returns a block of at least bytes aligned to align, reusing a freed block of the same size class if possible
+    void* Allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    // returns a block from Allocate() to the free list of its size class, never throws
+    void Deallocate(void* block, size_t bytes) noexcept;
+
+    // frees every slab at once, invalidating all blocks handed out by the pool
+    void Release();
+
+    // returns the number of bytes handed out and not yet deallocated
+    size_t BytesInUse() const { return bytes_in_use_; }
+
+    // returns the number of blocks handed out and not yet deallocated
+    size_t BlocksInUse() const { return blocks_in_use_; }
+
+    // returns the number of bytes reserved from the system
+    size_t BytesReserved() const;
+
+    // returns true if slabs are backed by huge pages
+    bool HugePages() const { return huge_pages_; }
+
+private:
+    static constexpr size_t granularity = 16;
+    static constexpr size_t huge_page_bytes = 2 * 1024 * 1024;
+
+    struct free_block { free_block* next; };
+    struct slab { void* memory; size_t bytes; };
+
+    bool huge_pages_;
+    size_t slab_bytes_;
+    char* cursor_;
+    char* end_;
+    size_t bytes_in_use_;
+    size_t blocks_in_use_;
+    std::vector<slab> slabs_;
+    std::vector<free_block*> free_lists_;
+
+    static size_t round_up(size_t n, size_t multiple) { return (n + multiple - 1) / multiple * multiple; }
+    static size_t size_class(size_t bytes) { return round_up(bytes, granularity) / granularity; }
+
+    // requests a new slab of at least bytes from the system
+    void NewSlab(size_t bytes);
+};
+
+inline void* skip_list_pool::Allocate(size_t bytes, const size_t align)
+{
+    const auto index = size_class(bytes);
+    bytes = index * granularity;
+
+    // every size class is seen here first, so Deallocate() never has to grow the free lists
+    if (index >= free_lists_.size()) free_lists_.resize(index + 1, nullptr);
+
+    // reuse a freed block of the same size class
+    if (free_lists_[index])
+    {
+        auto block = free_lists_[index];
+        free_lists_[index] = block->next;
+        bytes_in_use_ += bytes;
+        ++blocks_in_use_;
+        return block;
+    }
+
+    // bump allocate from the current slab
+    auto address = round_up(reinterpret_cast<std::uintptr_t>(cursor_), align);
+    if (!cursor_ || address + bytes > reinterpret_cast<std::uintptr_t>(end_))
+    {
+        NewSlab(bytes + align);
+        address = round_up(reinterpret_cast<std::uintptr_t>(cursor_), align);
+    }
+    cursor_ = reinterpret_cast<char*>(address + bytes);
+    bytes_in_use_ += bytes;
+    ++blocks_in_use_;
+    return reinterpret_cast<void*>(address);
+}
+
+inline void skip_list_pool::Deallocate(void* block, size_t bytes) noexcept
+{
+    const auto index = size_class(bytes);
+    assert(index < free_lists_.size());
+    bytes_in_use_ -= index * granularity;
+    --blocks_in_use_;
+
+    auto node = static_cast<free_block*>(block);
+    node->next = free_lists_[index];
+    free_lists_[index] = node;
+}
+
+inline void skip_list_pool::Release()
+{
+    for (const auto& s : slabs_)
+    {
+#ifdef __linux__
+        if (huge_pages_)
+        {
+            munmap(s.memory, s.bytes);
+            continue;
+        }
+#endif
+        ::operator delete(s.memory);
+    }
+
+    slabs_.clear();
+    free_lists_.clear();
+    cursor_ = end_ = nullptr;
+    bytes_in_use_ = 0;
+    blocks_in_use_ = 0;
+}
+
+inline size_t skip_list_pool::BytesReserved() const
+{
+    size_t bytes = 0;
+    for (const auto& s : slabs_) bytes += s.bytes;
+    return bytes;
+}
+
+inline void skip_list_pool::NewSlab(size_t bytes)
+{
+    bytes = bytes > slab_bytes_ ? round_up(bytes, huge_pages_ ? huge_page_bytes : granularity) : slab_bytes_;
+
+    void* memory = nullptr;
+#ifdef __linux__
+    if (huge_pages_)
+    {
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) throw std::bad_alloc();
+        madvise(memory, bytes, MADV_HUGEPAGE);
+    }
+    else
+#endif
+    memory = ::operator new(bytes);
+
+    slabs_.push_back({ memory, bytes });
+    cursor_ = static_cast<char*>(memory);
+    end_ = cursor_ + bytes;
+}
+
+
+/*
+ * Standard allocator drawing from a shared skip_list_pool. Copies and rebinds share the pool, so containers built from
+ * the same allocator object draw from one pool and Release() frees the blocks of all of them. A container should only
+ * call Release() when BlocksInUse() shows it holds every block, as skip_list::Clear() does.
+ * select_on_container_copy_construction() gives copied containers a fresh pool of their own.
+ */
+template <typename T>
+class skip_list_pool_allocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    // Constructor. Creates a new pool, optionally backed by huge pages
+    explicit skip_list_pool_allocator(bool huge_pages = false)
+        : pool_(std::make_shared<skip_list_pool>(huge_pages)) {}
+
+    // Rebinding constructor, shares the pool of other
+    template <typename U>
+    skip_list_pool_allocator(const skip_list_pool_allocator<U>& other) noexcept : pool_(other.pool_) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(pool_->Allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, size_t n) noexcept { pool_->Deallocate(p, n * sizeof(T)); }
+
+    // copies for a new container get a fresh pool with the same backing
+    skip_list_pool_allocator select_on_container_copy_construction() const
+    {
+        return skip_list_pool_allocator(pool_->HugePages());
+    }
+
+    // frees every block allocated from the pool at once, including those of other containers sharing it
+    void Release() { pool_->Release(); }
+
+    // returns the number of blocks handed out by the pool and not yet deallocated
+    size_t BlocksInUse() const { return pool_->BlocksInUse(); }
+
+    // returns the pool this allocator draws from
+    skip_list_pool& Pool() const { return *pool_; }
+
+    template <typename U>
+    friend bool operator==(const skip_list_pool_allocator& a, const skip_list_pool_allocator<U>& b) { return &a.Pool() == &b.Pool(); }
+    template <typename U>
+    friend bool operator!=(const skip_list_pool_allocator& a, const skip_list_pool_allocator<U>& b) { return !(a == b); }
+
+private:
+    template <typename U> friend class skip_list_pool_allocator;
+
+    std::shared_ptr<skip_list_pool> pool_;
+};
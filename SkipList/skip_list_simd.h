@@ -0,0 +1,243 @@
+/*
+ * SIMD search kernels for sorted blocks of arithmetic keys.
+ *
+ * CountLess() and CountLessEqual() return the number of keys in a block that are < (or <=) val. For a sorted block these
+ * are the lower_bound and upper_bound positions, computed without branching on the keys: whole vectors of keys are
+ * compared against val and the comparison mask is turned into a count with movemask + popcount.
+ *
+ * On x86-64 the AVX2 kernels are selected at runtime when the CPU supports them, falling back to SSE2 (SSE4.2 for 64 bit
+ * integers). Other platforms and key types use a branch free scalar loop. force_sse skips the AVX2 kernels.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SKIP_LIST_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace skip_list_simd
+{
+    /* branch free scalar count of keys less than (or greater than if Greater) val */
+    template <bool Greater, typename T>
+    unsigned ScalarCount(const T* keys, unsigned n, T val)
+    {
+        unsigned count = 0;
+        for (unsigned i = 0; i < n; ++i) count += Greater ? val < keys[i] : keys[i] < val;
+        return count;
+    }
+
+#ifdef SKIP_LIST_SIMD_X86
+
+    /* set to skip the AVX2 kernels even where the CPU supports them, so the SSE fallback can be tested */
+    inline bool force_sse = false;
+
+    /* true if the AVX2 kernels can be used, checked once */
+    inline bool HasAvx2()
+    {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2 && !force_sse;
+    }
+
+    /* true if the SSE4.2 kernels (64 bit integer compares) can be used, checked once */
+    inline bool HasSse42()
+    {
+        static const bool sse42 = __builtin_cpu_supports("sse4.2");
+        return sse42;
+    }
+
+    // flips the sign bit so unsigned values compare correctly with signed integer compares
+    template <bool Signed, typename U>
+    constexpr U Bias(U x) { return Signed ? x : x ^ (U(1) << (sizeof(U) * 8 - 1)); }
+
+
+    /* 64 bit integers, 4 keys per compare */
+    template <bool Greater, bool Signed>
+    __attribute__((target("avx2")))
+    unsigned CountI64Avx2(const std::uint64_t* keys, unsigned n, std::uint64_t val)
+    {
+        const auto v = _mm256_set1_epi64x(static_cast<long long>(Bias<Signed>(val)));
+        const auto bias = _mm256_set1_epi64x(static_cast<long long>(Bias<Signed>(std::uint64_t(0))));
+        unsigned count = 0, i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const auto k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            const auto mask = Greater ? _mm256_cmpgt_epi64(k, v) : _mm256_cmpgt_epi64(v, k);
+            count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+        }
+        return count;
+    }
+
+    /* 64 bit integers, 2 keys per compare */
+    template <bool Greater, bool Signed>
+    __attribute__((target("sse4.2")))
+    unsigned CountI64Sse(const std::uint64_t* keys, unsigned n, std::uint64_t val)
+    {
+        const auto v = _mm_set1_epi64x(static_cast<long long>(Bias<Signed>(val)));
+        const auto bias = _mm_set1_epi64x(static_cast<long long>(Bias<Signed>(std::uint64_t(0))));
+        unsigned count = 0, i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            const auto k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+            const auto mask = Greater ? _mm_cmpgt_epi64(k, v) : _mm_cmpgt_epi64(v, k);
+            count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+        }
+        return count;
+    }
+
+    /* 32 bit integers, 8 keys per compare */
+    template <bool Greater, bool Signed>
+    __attribute__((target("avx2")))
+    unsigned CountI32Avx2(const std::uint32_t* keys, unsigned n, std::uint32_t val)
+    {
+        const auto v = _mm256_set1_epi32(static_cast<int>(Bias<Signed>(val)));
+        const auto bias = _mm256_set1_epi32(static_cast<int>(Bias<Signed>(std::uint32_t(0))));
+        unsigned count = 0, i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const auto k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            const auto mask = Greater ? _mm256_cmpgt_epi32(k, v) : _mm256_cmpgt_epi32(v, k);
+            count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+        }
+        return count;
+    }
+
+    /* 32 bit integers, 4 keys per compare */
+    template <bool Greater, bool Signed>
+    unsigned CountI32Sse(const std::uint32_t* keys, unsigned n, std::uint32_t val)
+    {
+        const auto v = _mm_set1_epi32(static_cast<int>(Bias<Signed>(val)));
+        const auto bias = _mm_set1_epi32(static_cast<int>(Bias<Signed>(std::uint32_t(0))));
+        unsigned count = 0, i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const auto k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+            const auto mask = Greater ? _mm_cmpgt_epi32(k, v) : _mm_cmpgt_epi32(v, k);
+            count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+        }
+        return count;
+    }
+
+    /* doubles, 4 keys per compare */
+    template <bool Greater>
+    __attribute__((target("avx2")))
+    unsigned CountF64Avx2(const double* keys, unsigned n, double val)
+    {
+        const auto v = _mm256_set1_pd(val);
+        unsigned count = 0, i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const auto k = _mm256_loadu_pd(keys + i);
+            const auto mask = Greater ? _mm256_cmp_pd(v, k, _CMP_LT_OQ) : _mm256_cmp_pd(k, v, _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_pd(mask));
+        }
+        return count;
+    }
+
+    /* doubles, 2 keys per compare */
+    template <bool Greater>
+    unsigned CountF64Sse(const double* keys, unsigned n, double val)
+    {
+        const auto v = _mm_set1_pd(val);
+        unsigned count = 0, i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            const auto k = _mm_loadu_pd(keys + i);
+            const auto mask = Greater ? _mm_cmplt_pd(v, k) : _mm_cmplt_pd(k, v);
+            count += __builtin_popcount(_mm_movemask_pd(mask));
+        }
+        return count;
+    }
+
+    /* floats, 8 keys per compare */
+    template <bool Greater>
+    __attribute__((target("avx2")))
+    unsigned CountF32Avx2(const float* keys, unsigned n, float val)
+    {
+        const auto v = _mm256_set1_ps(val);
+        unsigned count = 0, i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const auto k = _mm256_loadu_ps(keys + i);
+            const auto mask = Greater ? _mm256_cmp_ps(v, k, _CMP_LT_OQ) : _mm256_cmp_ps(k, v, _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_ps(mask));
+        }
+        return count;
+    }
+
+    /* floats, 4 keys per compare */
+    template <bool Greater>
+    unsigned CountF32Sse(const float* keys, unsigned n, float val)
+    {
+        const auto v = _mm_set1_ps(val);
+        unsigned count = 0, i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const auto k = _mm_loadu_ps(keys + i);
+            const auto mask = Greater ? _mm_cmplt_ps(v, k) : _mm_cmplt_ps(k, v);
+            count += __builtin_popcount(_mm_movemask_ps(mask));
+        }
+        return count;
+    }
+
+#endif
+
+    /*
+     * Returns the number of keys less than (or greater than if Greater) val, using the widest kernel available for T.
+     * Keys left over after the last full vector are counted with the scalar loop.
+     */
+    template <bool Greater, typename T>
+    unsigned Count(const T* keys, unsigned n, T val)
+    {
+        static_assert(std::is_arithmetic<T>::value, "SIMD kernels need arithmetic keys");
+
+#ifdef SKIP_LIST_SIMD_X86
+        unsigned done = 0, count = 0;
+
+        if constexpr (std::is_integral<T>::value && sizeof(T) == 8)
+        {
+            constexpr bool is_signed = std::is_signed<T>::value;
+            const auto k = reinterpret_cast<const std::uint64_t*>(keys);
+            const auto v = static_cast<std::uint64_t>(val);
+            if (HasAvx2()) { count = CountI64Avx2<Greater, is_signed>(k, n, v); done = n & ~3u; }
+            else if (HasSse42()) { count = CountI64Sse<Greater, is_signed>(k, n, v); done = n & ~1u; }
+        }
+        else if constexpr (std::is_integral<T>::value && sizeof(T) == 4)
+        {
+            constexpr bool is_signed = std::is_signed<T>::value;
+            const auto k = reinterpret_cast<const std::uint32_t*>(keys);
+            const auto v = static_cast<std::uint32_t>(val);
+            if (HasAvx2()) { count = CountI32Avx2<Greater, is_signed>(k, n, v); done = n & ~7u; }
+            else { count = CountI32Sse<Greater, is_signed>(k, n, v); done = n & ~3u; }
+        }
+        else if constexpr (std::is_same<T, double>::value)
+        {
+            if (HasAvx2()) { count = CountF64Avx2<Greater>(keys, n, val); done = n & ~3u; }
+            else { count = CountF64Sse<Greater>(keys, n, val); done = n & ~1u; }
+        }
+        else if constexpr (std::is_same<T, float>::value)
+        {
+            if (HasAvx2()) { count = CountF32Avx2<Greater>(keys, n, val); done = n & ~7u; }
+            else { count = CountF32Sse<Greater>(keys, n, val); done = n & ~3u; }
+        }
+
+        return count + ScalarCount<Greater>(keys + done, n - done, val);
+#else
+        return ScalarCount<Greater>(keys, n, val);
+#endif
+    }
+
+    /* number of keys < val, the lower_bound position in a sorted block */
+    template <typename T>
+    unsigned CountLess(const T* keys, unsigned n, T val) { return Count<false>(keys, n, val); }
+
+    /* number of keys <= val, the upper_bound position in a sorted block */
+    template <typename T>
+    unsigned CountLessEqual(const T* keys, unsigned n, T val) { return n - Count<true>(keys, n, val); }
+}
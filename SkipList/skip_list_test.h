@@ -5,13 +5,14 @@
  * A skip list is an ordered sequence data structure with O(logn) running time for Insert(), Remove(), and Contains().
  * Advantages are fast searching like an ordered array, combined with fast insertion/deletion like a linked list.
  *
- * Should work with any type T that defines <,>, ==, !=, and operator--().
+ * Should work with any type T that defines <,>, ==, !=, and operator++().
  * 
  * Author: Mike Greber
  */
 
 #pragma once
 
+#include <string>
 #include <vector>
 #include "skip_list.h"
 #include "sorted_list.h"
@@ -20,21 +21,34 @@
 /*
  * Skip list wrapped class to implement sorted_list interface for testing.
  */
-template <typename T>
-class skip_list_test : public skip_list<T>, public sorted_list<T> 
+template <typename T, typename Allocator = std::allocator<T>>
+class skip_list_test : public skip_list<T, std::less<T>, Allocator>, public sorted_list<T> 
 {
+	typedef skip_list<T, std::less<T>, Allocator> base;
+	
 public:
 	// Constructor
-	skip_list_test(float p = 0.5) : skip_list<T>(p) {}
+	skip_list_test(float p = 0.5, std::string name = "skip list", const Allocator& allocator = Allocator())
+		: base(p, std::less<T>(), allocator), name_(std::move(name)) {}
+
+	// Constructor, seed makes the tower heights reproducible
+	skip_list_test(float p, std::uint64_t seed, std::string name = "skip list", const Allocator& allocator = Allocator())
+		: base(p, seed, std::less<T>(), allocator), name_(std::move(name)) {}
 
 	// sorted_list interface begin
-	std::string GetName() const override { return "skip list"; }
-	void Insert(T val) override { skip_list<T>::Insert(val); }
-	bool Remove(T val) override { return skip_list<T>::Remove(val); }
-	bool Contains(T val) override { return skip_list<T>::Contains(val); }
-	void Clear() override { skip_list<T>::Clear(); }
-	size_t Size() const override { return skip_list<T>::Size(); }
-	void Fill(T min, T max) override { Clear(); for (T i = max; min < i; --i) Insert(i); }
+	std::string GetName() const override { return name_; }
+	void Insert(T val) override { base::Insert(val); }
+	bool Remove(T val) override { return base::Remove(val); }
+	bool Contains(T val) override { return base::Contains(val); }
+	void Clear() override { base::Clear(); }
+	size_t Size() const override { return base::Size(); }
+	void Fill(T min, T max) override
+	{
+		// build in one pass from the sorted sequence instead of inserting each element
+		std::vector<T> sorted;
+		for (T i = min; !(max < i); ++i) sorted.push_back(i);
+		base::AssignSorted(sorted.begin(), sorted.end());
+	}
 	
 	std::vector<T> AsVector() const override
 	{
@@ -44,4 +58,7 @@ public:
 		return v;
 	}
 	// sorted_list interface end
+
+private:
+	std::string name_;
 };
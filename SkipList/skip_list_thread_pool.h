@@ -0,0 +1,118 @@
+/*
+ * Fixed size thread pool used to apply batches to the shards of sharded_skip_list in parallel.
+ *
+ * Run() queues a group of tasks and returns once all of them have finished. The calling thread works through queued
+ * tasks while it waits, so a pool with no threads runs everything on the caller, and groups queued by different threads
+ * at the same time share the workers.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class skip_list_thread_pool
+{
+public:
+    // Constructor, starts threads worker threads
+    explicit skip_list_thread_pool(unsigned threads)
+    {
+        workers_.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) workers_.emplace_back([this] { Work(); });
+    }
+
+    skip_list_thread_pool(const skip_list_thread_pool&) = delete;
+    skip_list_thread_pool& operator=(const skip_list_thread_pool&) = delete;
+
+    // Destructor, finishes queued tasks and joins the workers
+    ~skip_list_thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    // runs every task and returns once all have finished, rethrowing the first exception a task threw
+    void Run(std::vector<std::function<void()>>& tasks);
+
+    // returns the number of worker threads
+    unsigned Threads() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> queue_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    void Work();
+};
+
+inline void skip_list_thread_pool::Run(std::vector<std::function<void()>>& tasks)
+{
+    size_t left = tasks.size();
+    std::exception_ptr error;
+    std::condition_variable done;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& task : tasks)
+            queue_.emplace_back([&, this]
+            {
+                std::exception_ptr task_error;
+                try { task(); }
+                catch (...) { task_error = std::current_exception(); }
+
+                // notified under the lock, so done outlives the call
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (task_error && !error) error = task_error;
+                if (--left == 0) done.notify_all();
+            });
+    }
+    wake_.notify_all();
+
+    // help with queued tasks until the whole group is done
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (left)
+    {
+        if (queue_.empty())
+        {
+            done.wait(lock);
+            continue;
+        }
+        auto task = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
+
+inline void skip_list_thread_pool::Work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+
+        auto task = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * Ordered key-value map built on skip_list.
+ *
+ * Each entry is a skip_map_entry holding the key and its mapped value, stored once in the entry's tower node. Entries
+ * are ordered by Compare on the key alone, and each key appears at most once. Lookups search with the key directly so
+ * no temporary entry (or mapped value) is ever constructed to find one.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "skip_list.h"
+
+
+/*
+ * Key and mapped value of a skip_map element. The key is const since it decides the position of the entry, the mapped
+ * value can be modified in place through the list's read only iterators.
+ */
+template <typename K, typename V>
+struct skip_map_entry
+{
+    // constructs the mapped value in place from args
+    template <typename... Args>
+    explicit skip_map_entry(const K& key, Args&&... args) : first(key), second(std::forward<Args>(args)...) {}
+
+    template <typename... Args>
+    explicit skip_map_entry(K&& key, Args&&... args) : first(std::move(key)), second(std::forward<Args>(args)...) {}
+
+    const K first;
+    mutable V second;
+};
+
+
+/*
+ * Ordered map from K to V with O(logn) find(), try_emplace(), insert_or_assign(), and erase().
+ * Compare orders the keys, Allocator and LevelGenerator are passed on to the underlying skip_list.
+ */
+template <typename K, typename V, typename Compare = std::less<K>,
+          typename Allocator = std::allocator<skip_map_entry<K, V>>, typename LevelGenerator = skip_list_level_generator>
+class skip_map
+{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = skip_map_entry<K, V>;
+    using key_compare = Compare;
+
+    // orders entries by key, and compares entries directly with keys so lookups need no temporary entry
+    class value_compare
+    {
+    public:
+        explicit value_compare(const Compare& compare) : compare_(compare) {}
+
+        bool operator()(const value_type& a, const value_type& b) const { return compare_(a.first, b.first); }
+        bool operator()(const value_type& a, const K& b) const { return compare_(a.first, b); }
+        bool operator()(const K& a, const value_type& b) const { return compare_(a, b.first); }
+
+        const Compare& key_comp() const { return compare_; }
+
+    private:
+        Compare compare_;
+    };
+
+private:
+    typedef skip_list<value_type, value_compare, Allocator, LevelGenerator> list_type;
+
+public:
+    using iterator = typename list_type::iterator;
+
+    // Constructor. p is the probability that an entry is promoted to the next higher layer
+    explicit skip_map(float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+        : list_(p, value_compare(compare), allocator) {}
+
+    // Constructor, entry heights are generated from seed so the structure is reproducible
+    skip_map(float p, std::uint64_t seed, const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+        : list_(p, seed, value_compare(compare), allocator) {}
+
+    // returns an iterator to the entry with key, or end() if there is none
+    iterator find(const K& key) const { return iterator(list_.FindNode(key), &list_); }
+
+    // returns true if the map has an entry with key
+    bool contains(const K& key) const { return list_.FindNode(key); }
+
+    // returns the value mapped to key, inserting a default constructed value first if key is not in the map
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+    V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+    // inserts an entry with a value constructed from args if key is not in the map, otherwise does nothing (args are
+    // not moved from). Returns an iterator to the entry with key, and true if it was inserted
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) { return Emplace(key, std::forward<Args>(args)...); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) { return Emplace(std::move(key), std::forward<Args>(args)...); }
+
+    // inserts an entry for key with value, or assigns value to the existing entry. Returns an iterator to the entry,
+    // and true if it was inserted
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& value) { return Assign(key, std::forward<M>(value)); }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& value) { return Assign(std::move(key), std::forward<M>(value)); }
+
+    // removes the entry with key, returns the number of entries removed (0 or 1)
+    size_t erase(const K& key) { return list_.RemoveKey(key) ? 1 : 0; }
+
+    // removes all entries
+    void clear() { list_.Clear(); }
+
+    // returns the number of entries
+    size_t size() const { return list_.Size(); }
+
+    // returns true if the map has no entries
+    bool empty() const { return list_.Size() == 0; }
+
+    // returns the comparator ordering the keys
+    Compare key_comp() const { return list_.key_comp().key_comp(); }
+
+    // returns the number of bytes used by the nodes and layer heads of the map
+    size_t MemoryUsage() const { return list_.MemoryUsage(); }
+
+    iterator begin() const { return list_.begin(); }
+
+    iterator end() const { return list_.end(); }
+
+private:
+    list_type list_;
+
+    // inserts an entry from key and args unless key is already in the map
+    template <typename Key, typename... Args>
+    std::pair<iterator, bool> Emplace(Key&& key, Args&&... args)
+    {
+        auto result = list_.EmplaceUnique(std::forward<Key>(key), std::forward<Args>(args)...);
+        return { iterator(result.first, &list_), result.second };
+    }
+
+    // inserts an entry from key and value, or assigns value to the existing entry with key
+    template <typename Key, typename M>
+    std::pair<iterator, bool> Assign(Key&& key, M&& value)
+    {
+        auto result = list_.EmplaceUnique(std::forward<Key>(key), std::forward<M>(value));
+        if (!result.second) result.first->val.second = std::forward<M>(value);
+        return { iterator(result.first, &list_), result.second };
+    }
+};
@@ -11,6 +11,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
 #include "sorted_list.h"
 
 template <typename T>
@@ -0,0 +1,58 @@
+/*
+ * Template for ordered maps wrapped to implement the sorted_list interface for performance comparison of skip_map with
+ * std::map. Works with any map providing try_emplace(), find(), erase(), clear(), size(), and iteration over entries
+ * with a first member.
+ *
+ * Keys are the list elements and each key is mapped to a copy of itself, so mapped_type must be constructible from
+ * key_type. Should work with any key type that defines < and operator++().
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sorted_list.h"
+
+template <class Map>
+class sorted_map final : public sorted_list<typename Map::key_type>
+{
+	typedef typename Map::key_type T;
+
+public:
+
+	// Constructor
+	explicit sorted_map(std::string name) : name_(std::move(name)) {}
+
+	// Constructor, args are passed on to the constructor of the map
+	template <typename... Args>
+	sorted_map(std::string name, Args&&... args) : name_(std::move(name)), map_(std::forward<Args>(args)...) {}
+
+	// sorted_list interface begin
+	std::string GetName() const override { return name_; }
+	void Insert(T val) override { map_.try_emplace(val, val); }
+	bool Remove(T val) override { return map_.erase(val) != 0; }
+	bool Contains(T val) override { return map_.find(val) != map_.end(); }
+	void Clear() override { map_.clear(); }
+	size_t Size() const override { return map_.size(); }
+	void Fill(T min, T max) override { Clear(); for (T i = min; !(max < i); ++i) Insert(i); }
+
+	std::vector<T> AsVector() const override
+	{
+		std::vector<T> v;
+		v.reserve(Size());
+		for (auto& entry : map_) v.push_back(entry.first);
+		return v;
+	}
+	// sorted_list interface end
+
+	// returns the wrapped map
+	Map& Get() { return map_; }
+
+private:
+	std::string name_;
+	Map map_;
+};
@@ -11,6 +11,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "sorted_list.h"
 
 template <typename T>
@@ -0,0 +1,37 @@
+/*
+ * Element type used by the performance tests and the benchmark, a wrapped unsigned long long with only the operators
+ * the sorted lists need.
+ */
+
+#pragma once
+
+#include <ostream>
+
+class test_class
+{
+public:
+	test_class(const unsigned long long val) : val(val) {}
+	
+	// required for testing setup for fill() function
+	test_class& operator++()
+	{
+		++val;
+		return *this;
+	}
+
+	// required for testing setup for fill() function
+	test_class& operator--()
+	{
+		--val;
+		return *this;
+	}
+
+	// required for stl find functions for sorted_vector and sorted_linked_list
+	friend bool operator==(const test_class& lhs, const test_class& rhs) { return lhs.val == rhs.val; }
+	
+	bool operator<(const test_class& other) const { return val < other.val; }
+	friend std::ostream& operator<<(std::ostream& os, const test_class& obj){ return os << obj.val; }
+	
+private:
+	unsigned long long val;
+};
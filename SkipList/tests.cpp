@@ -1,51 +1,67 @@
 /*
 * Test functions for comparing skip_list and sorted_linked_list performance and correctness.
 */
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
 #include <random>
+#include <stdexcept>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <list>
+#include <map>
+#include <set>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 #include "tests.h"
 
 #include <forward_list>
 #include <ostream>
 
+#include "benchmark.h"
+#include "blocked_skip_list_test.h"
+#include "cow_skip_list.h"
+#include "concurrent_skip_list.h"
+#include "mapped_skip_list.h"
+#include "sharded_skip_list.h"
+#include "single_writer_skip_list.h"
+#include "skip_list_pool.h"
+#include "skip_list_simd.h"
+#include "skip_map.h"
 #include "skip_list_test.h"
 #include "sorted_linked_list.h"
+#include "sorted_map.h"
 #include "sorted_vector.h"
+#include "test_class.h"
+#include "versioned_skip_list.h"
 
 
-class test_class
-{
-public:
-	test_class(const unsigned long long val) : val(val) {}
-	
-	// required for testing setup for fill() function
-	test_class& operator++()
-	{
-		++val;
-		return *this;
-	}
+/*
+ * Replacement global operator new counting heap allocations, used to show the skip list hot path doesn't allocate.
+ */
+static std::atomic<unsigned long long> allocation_count(0);
 
-	// required for testing setup for fill() function
-	test_class& operator--()
-	{
-		--val;
-		return *this;
-	}
+void* operator new(std::size_t size)
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
 
-	// required for stl find functions for sorted_vector and sorted_linked_list
-	friend bool operator==(const test_class& lhs, const test_class& rhs) { return lhs.val == rhs.val; }
-	
-	bool operator<(const test_class& other) const { return val < other.val; }
-	friend std::ostream& operator<<(std::ostream& os, const test_class& obj){ return os << obj.val; }
-	
-private:
-	unsigned long long val;
-};
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 /*
  * calls Insert() with all elements in input on list
@@ -185,249 +201,877 @@ bool getInput(T& integer, const std::string& fail_message = " Invalid input ", b
  */
 void run_performance_test()
 {
-
-std::forward_list<int> t;
-	
-	struct results
-	{
-		results(std::string name)
-		: list_name(std::move(name)), insert_time(0), remove_time(0), contains_time(0) {}
-		std::string list_name;
-		unsigned long long insert_time;
-		unsigned long long remove_time;
-		unsigned long long contains_time;
-	};
-	
 	std::cout << "\n******************************************************************************************************" << std::endl;
 	std::cout << "\n Performance tests for Skip List vs Sorted Linked List and Sorted Vector List\n" << std::endl;
 	
 	std::random_device rd;
 	std::mt19937 g(rd());
-	
-	// skip_list_test<unsigned long long> skip_list;
-	// sorted_linked_list<unsigned long long> linked_list;
-	// sorted_vector<unsigned long long> vector_list;
-	//
-	// std::vector<sorted_list<unsigned long long>*> lists { &skip_list };
-
-	skip_list_test<test_class> skip_list;
-	sorted_linked_list<test_class> linked_list;
-	sorted_vector<test_class> vector_list;
 
-	std::vector<sorted_list<test_class>*> lists { &skip_list };
-	
-	std::vector<results> results{ skip_list.GetName() };
-	
+	// Insert(), Remove(), and Contains() are timed by the benchmark engine shared with skiplist_bench
+	benchmark_options options;
+	options.structures = { "skip_list" };
 
-	std::cout << "\n Compare with Sorted Linked List (slow)? (y/n): ";
-	char compare_linked = '0';
-	while (getInput(compare_linked) && compare_linked != 'y' && compare_linked != 'n')
-		std::cout << "\n                                         (y/n): ";
-	
-	if (compare_linked == 'y')
-	{
-		lists.push_back(&linked_list);
-		results.emplace_back(linked_list.GetName());
-	}
-	
-	std::cout << "\n             Compare with Sorted Vector? (y/n): ";
-	char compare_vector = '0';
-	while (getInput(compare_vector) && compare_vector != 'y' && compare_vector != 'n')
-		std::cout << "\n                                         (y/n): ";
-	
-	if (compare_vector == 'y')
+	// asks a yes or no question, adding structures to the benchmark on yes
+	const auto ask = [&](const char* question, std::initializer_list<const char*> structures)
 	{
-		lists.push_back(&vector_list);
-		results.emplace_back(vector_list.GetName());
-	}
+		std::cout << question;
+		char answer = '0';
+		while (getInput(answer) && answer != 'y' && answer != 'n')
+			std::cout << "\n                                         (y/n): ";
+		if (answer == 'y') options.structures.insert(options.structures.end(), structures.begin(), structures.end());
+		return answer == 'y';
+	};
 
-	if (compare_linked == 'y') 
+	ask("\n          Compare with Pooled Skip List? (y/n): ", { "pooled_skip_list" });
+	ask("\n         Compare with Blocked Skip List? (y/n): ", { "blocked_skip_list" });
+	ask("\n          Compare Skip Map with std::map? (y/n): ", { "skip_map", "std_map" });
+	const bool compare_linked = ask("\n Compare with Sorted Linked List (slow)? (y/n): ", { "linked_list" });
+	const bool compare_vector = ask("\n             Compare with Sorted Vector? (y/n): ", { "vector" });
+
+	if (compare_linked) 
 		std::cout << "\n ** N < 10,000 recommended for Sorted Linked List test (slow search) **" << std::endl;
-	else if (compare_vector == 'y')
+	else if (compare_vector)
 		std::cout << "\n ** N > 100,000 recommended for Sorted Vector List test to show benefit of Skip List **" << std::endl;
 	
+	// run_benchmark() rejects sizes and repetitions of 0, so both are asked again until positive
 	std::cout << "\n                 Enter N for performance tests: ";
-	long long n;
-	getInput(n);
+	long long n = 0;
+	while (getInput(n) && n <= 0)
+		std::cout << "\n                                    (N > 0): ";
 	
 	std::cout << "\n                    Enter repetitions per test: ";
-	unsigned int repetitions;
-	getInput(repetitions);
-	
+	long long repetitions = 0;
+	while (getInput(repetitions) && (repetitions <= 0 || repetitions > std::numeric_limits<unsigned>::max()))
+		std::cout << "\n                          (repetitions > 0): ";
+
+	options.n = n;
+	options.repetitions = static_cast<unsigned>(repetitions);
+	options.seed = (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+
+	// prints the time of each structure for one operation and how it compares with the skip list
+	const auto print_times = [](const std::vector<benchmark_result>& results)
+	{
+		std::cout << " Execution Time      ";
+		for (const auto& result : results) printf("%17lld ms", static_cast<long long>(result.nanoseconds / 1000));
+		std::cout << std::endl;
+		std::cout << " Skip List Speed Up %";
+		for (const auto& result : results)
+			printf("%19.2f%%", 100 * result.nanoseconds / results[0].nanoseconds - 100);
+		std::cout << std::endl;
+	};
+
+	// results of each operation, in the order of benchmark_operations()
+	std::vector<std::vector<benchmark_result>> timed;
+	for (const auto& operation : benchmark_operations())
+	{
+		options.operations = { operation };
+		timed.push_back(run_benchmark(options, &std::cout));
+
+		std::cout << "\n\n " << benchmark_call_name(operation) << " Results (ms = microseconds):\n" << std::endl;
+		std::cout << "                     ";
+		for (const auto& result : timed.back()) printf("%20s", result.name.c_str());
+		std::cout << std::endl;
+		print_times(timed.back());
+	}
+
 	constexpr int multiplier = 5;
 	std::vector<unsigned long long> input(n);
 	for (long long i = 0; i < n; ++i) input[i] = i * multiplier;
+	std::shuffle(input.begin(), input.end(), g);
 	const long long n_existing = n * multiplier;
-	
-	std::cout << " -----------------------------------------------------------------------------------------------------" << std::endl;
-	std::cout << "\n Testing Insert() for";
-	for (const auto list : lists) std::cout << " { " << list->GetName() << " }";
-	std::cout <<" by\n inserting " << n << " elements in random order into a list containing " << n_existing << " elements." << std::endl;
 
-	for (unsigned i = 0; i < lists.size(); ++i)
-	{
-		auto& list = lists[i];
-		auto& result = results[i];
-	
-		result.insert_time = time(
-		"\n  Testing Insert() for " + list->GetName(),
+	// the remaining tests run on a skip list filled like it is for the Contains() test
+	skip_list_test<test_class> skip_list;
+	skip_list.Fill(n_existing / 4, n_existing * 3/4);
+
+	const double element_bytes = static_cast<double>(skip_list.MemoryUsage()) / static_cast<double>(skip_list.Size());
+	const double layer_node_bytes = skip_list.AverageHeight() * (sizeof(test_class) + 3 * sizeof(void*));
+	std::cout << "\n Skip list memory usage for " << skip_list.Size() << " elements:" << std::endl;
+	printf("   Average tower height:                %12.2f layers\n", skip_list.AverageHeight());
+	printf("   Tower nodes (one node per element):  %12.2f bytes per element\n", element_bytes);
+	printf("   Equivalent with one node per layer:  %12.2f bytes per element\n", layer_node_bytes);
+
+	// heap allocations per call, tower nodes are the only allocations expected
+	auto allocations = allocation_count.load();
+	containsList(input, skip_list);
+	const auto contains_allocations = allocation_count.load() - allocations;
+	allocations = allocation_count.load();
+	insertList(input, skip_list);
+	const auto insert_allocations = allocation_count.load() - allocations;
+	printf("   Heap allocations per Contains():     %12.2f\n", static_cast<double>(contains_allocations) / n);
+	printf("   Heap allocations per Insert():       %12.2f\n", static_cast<double>(insert_allocations) / n);
+
+	// range workloads on the skip list, each range covers range_width consecutive keys
+	const long long range_width = 100;
+	const long long range_count = std::max(1LL, n / range_width);
+	std::uniform_int_distribution<long long> range_distribution(0, n_existing - range_width);
+	std::vector<long long> range_starts(range_count);
+	for (auto& start : range_starts) start = range_distribution(g);
+
+	// scanning from begin() is O(n) per range, so it only runs on the first few ranges
+	const long long head_scan_count = std::min(range_count, 10LL);
+
+	std::cout << "\n Testing range queries for skip list on " << range_count << " ranges of " << range_width << " keys." << std::endl;
+	unsigned long long scanned = 0;
+
+	const auto scan_time = time(
+		"\n  Testing range scan with LowerBound() for skip list",
+		[&] { scanned = 0; },
 		[&]
 		{
-			// refill list
-			list->Fill(0, n_existing);
-		
-			// shuffle input
-			std::shuffle(input.begin(), input.end(), g);
+			for (const auto start : range_starts)
+			{
+				const test_class hi(start + range_width);
+				for (auto it = skip_list.LowerBound(start); it != skip_list.end() && *it < hi; ++it) ++scanned;
+			}
+		},
+		repetitions);
+
+	const auto head_scan_time = time(
+		"\n  Testing range scan from begin() for skip list",
+		[&] { scanned = 0; },
+		[&]
+		{
+			for (long long i = 0; i < head_scan_count; ++i)
+			{
+				const test_class lo(range_starts[i]), hi(range_starts[i] + range_width);
+				auto it = skip_list.begin();
+				while (it != skip_list.end() && *it < lo) ++it;
+				for (; it != skip_list.end() && *it < hi; ++it) ++scanned;
+			}
 		},
-		[&]()
+		repetitions);
+
+	const auto erase_range_time = time(
+		"\n  Testing range delete with EraseRange() for skip list",
+		[&] { skip_list.Fill(0, n_existing); },
+		[&] { for (const auto start : range_starts) skip_list.EraseRange(start, start + range_width); },
+		repetitions);
+
+	const auto remove_range_time = time(
+		"\n  Testing range delete with Remove() per key for skip list",
+		[&] { skip_list.Fill(0, n_existing); },
+		[&]
 		{
-			// call Insert() on list with all inputs
-			insertList(input, *list);
+			for (const auto start : range_starts)
+				for (long long key = start; key < start + range_width; ++key) skip_list.Remove(key);
 		},
 		repetitions);
+
+	std::cout << "\n Skip list range results for ranges of " << range_width << " keys (ms = microseconds):" << std::endl;
+	printf("   Range scan with LowerBound():        %12.2f ms per range\n", static_cast<double>(scan_time) / range_count);
+	printf("   Range scan from begin():             %12.2f ms per range\n", static_cast<double>(head_scan_time) / head_scan_count);
+	printf("   Range delete with EraseRange():      %12.2f ms per range\n", static_cast<double>(erase_range_time) / range_count);
+	printf("   Range delete with Remove() per key:  %12.2f ms per range\n", static_cast<double>(remove_range_time) / range_count);
+
+	// clustered workloads, each key is a small random step from the previous one
+	std::uniform_int_distribution<long long> step_distribution(-8, 24);
+	std::vector<long long> clustered(n);
+	long long key = 0;
+	for (auto& k : clustered)
+	{
+		key = std::min(std::max(0LL, key + step_distribution(g)), n_existing);
+		k = key;
 	}
 
-	std::cout << "\n\n Insert() Results (ms = microseconds):\n" << std::endl;
-	std::cout << "                     ";
-	for (const auto& result : results) printf("%20s", result.list_name.c_str());
-	std::cout << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.insert_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].insert_time) / static_cast<double>(results[0].insert_time) - 100);
-	std::cout << std::endl;
+	std::cout << "\n Testing clustered keys for skip list, " << n << " keys each a step in [-8, 24] from the last." << std::endl;
+	skip_list.Fill(0, n_existing);
 
+	const auto clustered_time = time(
+		"\n  Testing Contains() from the top for skip list",
+		[] {},
+		[&] { for (const auto k : clustered) skip_list.Contains(k); },
+		repetitions);
 
+	skip_list.UseFinger(true);
+	const auto finger_time = time(
+		"\n  Testing Contains() from the last finger for skip list",
+		[] {},
+		[&] { for (const auto k : clustered) skip_list.Contains(k); },
+		repetitions);
+	skip_list.UseFinger(false);
 
+	const auto hint_time = time(
+		"\n  Testing LowerBound() from the previous result for skip list",
+		[] {},
+		[&]
+		{
+			auto hint = skip_list.begin();
+			for (const auto k : clustered) hint = skip_list.LowerBound(hint, k);
+		},
+		repetitions);
 
-	std::cout <<"\n -----------------------------------------------------------------------------------------------------" << std::endl;
-	std::cout << "\n Testing Remove() for";
-	for (const auto list : lists) std::cout << " { " << list->GetName() << " }";
-	std::cout << " by\n calling Remove() with " << n << " elements on a list containing " << n_existing / 2 << " elements." <<
-		"\n 50% of calls will be misses. " << std::endl;
+	// sequential inserts between existing keys, ascending
+	const auto sequential_insert_time = time(
+		"\n  Testing ascending Insert() from the top for skip list",
+		[&] { skip_list.Fill(0, n_existing); },
+		[&] { for (long long i = 0; i < n; ++i) skip_list.Insert(i * multiplier); },
+		repetitions);
 
-	for (unsigned i = 0; i < lists.size(); ++i)
-	{
-		auto& list = lists[i];
-		auto& result = results[i];
-	
-		result.remove_time = time(
-		"\n  Testing Remove() for " + list->GetName(),
+	skip_list.UseFinger(true);
+	const auto sequential_finger_time = time(
+		"\n  Testing ascending Insert() from the last finger for skip list",
+		[&] { skip_list.Fill(0, n_existing); },
+		[&] { for (long long i = 0; i < n; ++i) skip_list.Insert(i * multiplier); },
+		repetitions);
+	skip_list.UseFinger(false);
+
+	const auto sequential_hint_time = time(
+		"\n  Testing ascending Insert() with the previous element as hint for skip list",
+		[&] { skip_list.Fill(0, n_existing); },
 		[&]
 		{
-			// refill list with only middle elements
-			list->Fill(n_existing / 4, n_existing * 3/4);
-		
-			// shuffle input
-			std::shuffle(input.begin(), input.end(), g);
+			// the hinted overloads are hidden by the sorted_list interface of skip_list_test
+			auto& list = static_cast<::skip_list<test_class>&>(skip_list);
+			auto hint = list.begin();
+			for (long long i = 0; i < n; ++i) hint = list.Insert(hint, i * multiplier);
+		},
+		repetitions);
+
+	std::cout << "\n Skip list clustered key results for " << n << " calls (ms = microseconds):" << std::endl;
+	printf("   Clustered Contains() from the top:   %12lld ms\n", clustered_time);
+	printf("   Clustered Contains() with finger:    %12lld ms\n", finger_time);
+	printf("   Clustered LowerBound() with hint:    %12lld ms\n", hint_time);
+	printf("   Ascending Insert() from the top:     %12lld ms\n", sequential_insert_time);
+	printf("   Ascending Insert() with finger:      %12lld ms\n", sequential_finger_time);
+	printf("   Ascending Insert() with hint:        %12lld ms\n", sequential_hint_time);
+
+	// positional queries, walking the iterator is O(n) per query so it only runs on the first few
+	indexed_skip_list<test_class> indexed;
+	skip_list.Fill(0, n_existing);
+	indexed.AssignSorted(skip_list.begin(), skip_list.end());
+	std::uniform_int_distribution<size_t> position_distribution(0, indexed.Size() - 1);
+	std::vector<size_t> positions(n);
+	for (auto& position : positions) position = position_distribution(g);
+	const long long walk_count = std::min(n, 10LL);
+
+	std::cout << "\n Testing positional queries for indexed skip list on " << indexed.Size() << " elements." << std::endl;
+	const auto at_time = time(
+		"\n  Testing At() for indexed skip list",
+		[] {},
+		[&] { for (const auto position : positions) indexed.At(position); },
+		repetitions);
+
+	const auto walk_time = time(
+		"\n  Testing walking to a position from begin() for skip list",
+		[] {},
+		[&]
+		{
+			for (long long i = 0; i < walk_count; ++i)
+			{
+				auto it = skip_list.begin();
+				std::advance(it, positions[i]);
+			}
+		},
+		repetitions);
+
+	const auto rank_time = time(
+		"\n  Testing Rank() for indexed skip list",
+		[] {},
+		[&] { for (const auto k : clustered) indexed.Rank(k); },
+		repetitions);
+
+	std::cout << "\n Indexed skip list results (ms = microseconds):" << std::endl;
+	printf("   At():                                %12.2f ms per call\n", static_cast<double>(at_time) / n);
+	printf("   Walk from begin():                   %12.2f ms per call\n", static_cast<double>(walk_time) / walk_count);
+	printf("   Rank():                              %12.2f ms per call\n", static_cast<double>(rank_time) / n);
+	printf("   Memory, indexed skip list:           %12.2f bytes per element\n",
+		static_cast<double>(indexed.MemoryUsage()) / static_cast<double>(indexed.Size()));
+	printf("   Memory, skip list:                   %12.2f bytes per element\n",
+		static_cast<double>(skip_list.MemoryUsage()) / static_cast<double>(skip_list.Size()));
+
+	// batched lookups on random keys, half of them in the list
+	std::vector<test_class> lookups;
+	lookups.reserve(input.size());
+	for (const auto i : input) lookups.emplace_back(i / 2);
+	std::shuffle(lookups.begin(), lookups.end(), g);
+	std::vector<bool> lookup_results(lookups.size());
+
+	std::cout << "\n Testing batched lookups for skip list on " << skip_list.Size() << " elements." << std::endl;
+	const auto scalar_time = time(
+		"\n  Testing Contains() one key at a time for skip list",
+		[] {},
+		[&] { for (size_t i = 0; i < lookups.size(); ++i) lookup_results[i] = skip_list.Contains(lookups[i]); },
+		repetitions);
+
+	const auto batch_time = time(
+		"\n  Testing ContainsBatch() for skip list",
+		[] {},
+		[&] { skip_list.ContainsBatch(lookups.begin(), lookups.end(), lookup_results.begin()); },
+		repetitions);
+
+	std::cout << "\n Batched lookup results for " << lookups.size() << " keys (ms = microseconds):" << std::endl;
+	printf("   Contains() one key at a time:        %12lld ms\n", scalar_time);
+	printf("   ContainsBatch():                     %12lld ms\n", batch_time);
+	printf("   Speed up:                            %12.2fx\n", static_cast<double>(scalar_time) / static_cast<double>(batch_time));
+
+	// copies of the full skip list
+	std::cout << "\n Testing copies of skip list with " << skip_list.Size() << " elements." << std::endl;
+	const ::skip_list<test_class>& source = skip_list;
+	const auto clone_time = time(
+		"\n  Testing copy constructor (structural clone) for skip list",
+		[] {},
+		[&] { ::skip_list<test_class> copy(source); },
+		repetitions);
+
+	const auto reinsert_time = time(
+		"\n  Testing Insert() of every element into an empty skip list",
+		[] {},
+		[&]
+		{
+			::skip_list<test_class> copy;
+			for (const auto& val : source) copy.Insert(val);
 		},
-		[&]()
+		repetitions);
+
+	cow_skip_list<test_class> cow{ ::skip_list<test_class>(source) };
+	const auto snapshot_time = time(
+		"\n  Testing Snapshot() of copy-on-write skip list",
+		[] {},
+		[&] { for (int i = 0; i < 1000; ++i) auto snapshot = cow.Snapshot(); },
+		repetitions);
+
+	std::cout << "\n Copy results for " << skip_list.Size() << " elements (ms = microseconds):" << std::endl;
+	printf("   Copy constructor (structural clone): %12lld ms\n", clone_time);
+	printf("   Insert() of every element:           %12lld ms\n", reinsert_time);
+	printf("   Copy-on-write Snapshot():            %12.3f ms\n", static_cast<double>(snapshot_time) / 1000);
+
+	// restarting from a saved file, mapping it against rebuilding the list with Insert()
+	const auto path = (std::filesystem::temp_directory_path() / "skip_list_perf.bin").string();
+	std::cout << "\n Testing a restart of skip list with " << skip_list.Size() << " elements from " << path << "." << std::endl;
+	const auto save_time = time(
+		"\n  Testing Save() for skip list",
+		[] {},
+		[&] { source.Save(path); },
+		repetitions);
+
+	const auto open_time = time(
+		"\n  Testing opening the saved file as a mapped skip list and a first Contains()",
+		[] {},
+		[&]
 		{
-			// call Remove() on list with all inputs
-			removeList(input, *list);
+			const mapped_skip_list<test_class> mapped(path);
+			mapped.Contains(lookups.front());
 		},
 		repetitions);
+
+	unsigned long long mapped_contains_time;
+	{
+		const mapped_skip_list<test_class> mapped(path);
+		mapped_contains_time = time(
+			"\n  Testing Contains() for mapped skip list",
+			[] {},
+			[&] { for (size_t i = 0; i < lookups.size(); ++i) lookup_results[i] = mapped.Contains(lookups[i]); },
+			repetitions);
 	}
+	std::filesystem::remove(path);
+
+	std::cout << "\n Restart results for " << skip_list.Size() << " elements (ms = microseconds):" << std::endl;
+	printf("   Save():                              %12lld ms\n", save_time);
+	printf("   Open mapped skip list (cold start):  %12lld ms\n", open_time);
+	printf("   Insert() of every element (rebuild): %12lld ms\n", reinsert_time);
+	printf("   Contains() of the lookups, mapped:   %12lld ms\n", mapped_contains_time);
+	printf("   Contains() of the lookups, in memory:%12lld ms\n", scalar_time);
+
+	// merging sorted runs, relinking towers against inserting one list into the other, for a run of similar size and a
+	// run 1% the size (merged by galloping)
+	::skip_list<test_class> run;
+	::skip_list<test_class> small_run;
+	for (long long i = 1; i < n_existing; i += 2) run.Insert(i);
+	for (long long i = 1; i < n_existing; i += 200) small_run.Insert(i);
+	std::cout << "\n Testing merges into skip list with " << skip_list.Size() << " elements of runs with " << run.Size() <<
+		" and " << small_run.Size() << " elements." << std::endl;
+
+	::skip_list<test_class> target;
+	::skip_list<test_class> merged_run;
+	const auto merge_time = time(
+		"\n  Testing Merge() of the run for skip list",
+		[&] { target = source; merged_run = run; },
+		[&] { target.Merge(std::move(merged_run)); },
+		repetitions);
 
-	std::cout << "\n\n Remove() Results (ms = microseconds):\n" << std::endl;
-	std::cout << "                     ";
-	for (const auto& result : results) printf("%20s", result.list_name.c_str());
-	std::cout << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.remove_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].remove_time) / static_cast<double>(results[0].remove_time) - 100);
-	std::cout << std::endl;
+	const auto insert_run_time = time(
+		"\n  Testing Insert() of every element of the run for skip list",
+		[&] { target = source; },
+		[&] { for (const auto& val : run) target.Insert(val); },
+		repetitions);
 
+	const auto merge_small_time = time(
+		"\n  Testing Merge() of the small run for skip list",
+		[&] { target = source; merged_run = small_run; },
+		[&] { target.Merge(std::move(merged_run)); },
+		repetitions);
 
+	const auto insert_small_time = time(
+		"\n  Testing Insert() of every element of the small run for skip list",
+		[&] { target = source; },
+		[&] { for (const auto& val : small_run) target.Insert(val); },
+		repetitions);
 
+	const auto intersect_time = time(
+		"\n  Testing Intersect() with the small run for skip list",
+		[] {},
+		[&] { source.Intersect(small_run); },
+		repetitions);
 
-	std::cout <<"\n -----------------------------------------------------------------------------------------------------" << std::endl;
-	std::cout << "\n Testing Contains() for";
-	for (const auto list : lists) std::cout << " { " << list->GetName() << " }";
-	std::cout << " by\n calling Contains() with " << n << " elements on a list containing " << n_existing / 2 << " elements." <<
-		"\n 50% of calls will be misses. " << std::endl;
+	const auto contains_small_time = time(
+		"\n  Testing Contains() of every element of the small run for skip list",
+		[] {},
+		[&]
+		{
+			::skip_list<test_class> intersection;
+			for (const auto& val : small_run) if (source.Contains(val)) intersection.Insert(val);
+		},
+		repetitions);
 
-	for (const auto list : lists)
+	std::cout << "\n Merge results (ms = microseconds):" << std::endl;
+	printf("   Merge() of the run:                  %12lld ms\n", merge_time);
+	printf("   Insert() of the run:                 %12lld ms\n", insert_run_time);
+	printf("   Merge() of the small run:            %12lld ms\n", merge_small_time);
+	printf("   Insert() of the small run:           %12lld ms\n", insert_small_time);
+	printf("   Intersect() with the small run:      %12lld ms\n", intersect_time);
+	printf("   Contains() of the small run:         %12lld ms\n", contains_small_time);
+
+	// splitting the list in half by key and joining it back, against moving the upper half into a new list one element at
+	// a time. Unindexed lists count the shorter half, indexed lists know its size from the widths
+	const test_class middle(n_existing / 2);
+	::skip_list<test_class> upper;
+	std::cout << "\n Testing splits of skip list with " << skip_list.Size() << " elements at " << middle << "." << std::endl;
+	const auto split_time = time(
+		"\n  Testing Split() for skip list",
+		[&] { target = source; upper.Clear(); },
+		[&] { upper = target.Split(middle); },
+		repetitions);
+
+	const auto join_time = time(
+		"\n  Testing Join() for skip list",
+		[&] { target = source; upper = target.Split(middle); },
+		[&] { target.Join(std::move(upper)); },
+		repetitions);
+
+	indexed_skip_list<test_class> indexed_target;
+	indexed_skip_list<test_class> indexed_upper;
+	const auto indexed_split_time = time(
+		"\n  Testing Split() for indexed skip list",
+		[&] { indexed_target = indexed; indexed_upper.Clear(); },
+		[&] { indexed_upper = indexed_target.Split(middle); },
+		repetitions);
+
+	const auto move_half_time = time(
+		"\n  Testing Insert() of the upper half into a new list and EraseRange() for skip list",
+		[&] { target = source; upper.Clear(); },
+		[&]
+		{
+			for (auto it = target.LowerBound(middle); it != target.end(); ++it) upper.Insert(*it);
+			target.EraseRange(middle, test_class(n_existing + 1));
+		},
+		repetitions);
+
+	std::cout << "\n Split results (ms = microseconds):" << std::endl;
+	printf("   Split(), skip list:                  %12lld ms\n", split_time);
+	printf("   Split(), indexed skip list:          %12lld ms\n", indexed_split_time);
+	printf("   Join(), skip list:                   %12lld ms\n", join_time);
+	printf("   Insert() of the upper half:          %12lld ms\n", move_half_time);
+
+	// walking the list backwards, through the link back in each tower or, without them, by searching for the element
+	// before, against walking it forwards
+	const ::skip_list<test_class, std::less<test_class>, std::allocator<test_class>, skip_list_level_generator,
+		skip_list_unindexed, skip_list_singly_linked> singly(source.begin(), source.end(), sorted_tag);
+	size_t visited = 0;
+	std::cout << "\n Testing reverse scans of skip list with " << skip_list.Size() << " elements." << std::endl;
+	const auto forward_scan_time = time(
+		"\n  Testing forward scan for skip list",
+		[] {},
+		[&] { for (auto it = source.begin(); it != source.end(); ++it) visited += *it < middle; },
+		repetitions);
+
+	const auto reverse_scan_time = time(
+		"\n  Testing reverse scan for skip list",
+		[] {},
+		[&] { for (auto it = source.rbegin(); it != source.rend(); ++it) visited += *it < middle; },
+		repetitions);
+
+	const auto singly_reverse_scan_time = time(
+		"\n  Testing reverse scan for singly linked skip list",
+		[] {},
+		[&] { for (auto it = singly.rbegin(); it != singly.rend(); ++it) visited += *it < middle; },
+		repetitions);
+
+	const auto back_time = time(
+		"\n  Testing Back() for skip list",
+		[] {},
+		[&] { for (long long i = 0; i < n; ++i) visited += source.Back() < middle; },
+		repetitions);
+
+	std::cout << "\n Reverse scan results (ms = microseconds):" << std::endl;
+	printf("   Forward scan:                        %12lld ms\n", forward_scan_time);
+	printf("   Reverse scan:                        %12lld ms\n", reverse_scan_time);
+	printf("   Reverse scan, singly linked:         %12lld ms\n", singly_reverse_scan_time);
+	printf("   Back():                              %12.2f ms per call\n", static_cast<double>(back_time) / n);
+	printf("   Memory, skip list:                   %12.2f bytes per element\n",
+		static_cast<double>(source.MemoryUsage()) / static_cast<double>(source.Size()));
+	printf("   Memory, singly linked skip list:     %12.2f bytes per element\n",
+		static_cast<double>(singly.MemoryUsage()) / static_cast<double>(singly.Size()));
+
+	// Stats() walking the list against reading the counts kept while tracking stats, and what keeping them costs Insert()
+	// and Remove()
+	::skip_list<test_class> tracked;
+	std::cout << "\n Testing Stats() of skip list with " << skip_list.Size() << " elements." << std::endl;
+	const auto stats_time = time(
+		"\n  Testing Stats() for skip list",
+		[] {},
+		[&] { visited += source.Stats().layer_nodes.size(); },
+		repetitions);
+
+	const auto tracked_stats_time = time(
+		"\n  Testing Stats() for skip list tracking stats",
+		[&]
+		{
+			tracked = source;
+			tracked.TrackStats(true);
+		},
+		[&] { visited += tracked.Stats().layer_nodes.size(); },
+		repetitions);
+
+	const auto untracked_insert_time = time(
+		"\n  Testing Insert() and Remove() for skip list",
+		[&] { target = source; },
+		[&]
+		{
+			for (const auto i : input) target.Insert(test_class(i + 1));
+			for (const auto i : input) target.Remove(test_class(i + 1));
+		},
+		repetitions);
+
+	const auto tracked_insert_time = time(
+		"\n  Testing Insert() and Remove() for skip list tracking stats",
+		[&]
+		{
+			tracked = source;
+			tracked.TrackStats(true);
+		},
+		[&]
+		{
+			for (const auto i : input) tracked.Insert(test_class(i + 1));
+			for (const auto i : input) tracked.Remove(test_class(i + 1));
+		},
+		repetitions);
+
+	const auto stats = source.Stats();
+	std::cout << "\n Stats results (ms = microseconds):" << std::endl;
+	printf("   Stats():                             %12lld ms\n", stats_time);
+	printf("   Stats(), tracking stats:             %12lld ms\n", tracked_stats_time);
+	printf("   Insert() and Remove():               %12lld ms\n", untracked_insert_time);
+	printf("   Insert() and Remove(), tracking:     %12lld ms\n", tracked_insert_time);
+	printf("   Promotion ratio (p = %.2f):          %12.3f\n", stats.p, stats.promotion_ratio);
+	printf("   Layers:                              %12zu\n", stats.layer_nodes.size());
+
+	// searches under a natural log height cap, which the list used to have, against the log_1/p(n) cap, then after
+	// AutoTune() has lifted the cap and seen a read heavy mix
+	::skip_list<test_class> ln_capped;
+	ln_capped.SetHeightCap(static_cast<unsigned>(std::log(static_cast<double>(source.Size()))) + 1);
+	for (const auto& val : source) ln_capped.Insert(val);
+	std::cout << "\n Testing height caps of skip list with " << skip_list.Size() << " elements." << std::endl;
+	const auto ln_cap_time = time(
+		"\n  Testing Contains() for skip list with a natural log height cap",
+		[] {},
+		[&] { for (const auto& val : lookups) ln_capped.Contains(val); },
+		repetitions);
+
+	const auto default_cap_time = time(
+		"\n  Testing Contains() for skip list",
+		[] {},
+		[&] { for (const auto& val : lookups) source.Contains(val); },
+		repetitions);
+
+	ln_capped.SetHeightCap(0);
+	ln_capped.AutoTune(true);
+	for (int round = 0; round < 8; ++round)
 	{
-		// refill list with only middle elements
-		list->Fill(n_existing / 4, n_existing * 3/4);
+		for (const auto& val : lookups) ln_capped.Contains(val);
+		ln_capped.Insert(test_class(n_existing + 1));
+		ln_capped.Remove(test_class(n_existing + 1));
 	}
+	const auto tuned_time = time(
+		"\n  Testing Contains() for skip list with a natural log height cap after AutoTune()",
+		[] {},
+		[&] { for (const auto& val : lookups) ln_capped.Contains(val); },
+		repetitions);
+
+	std::cout << "\n Height cap results (ms = microseconds):" << std::endl;
+	printf("   Contains(), natural log cap:         %12lld ms\n", ln_cap_time);
+	printf("   Contains(), log_1/p cap:             %12lld ms\n", default_cap_time);
+	printf("   Contains(), after AutoTune():        %12lld ms\n", tuned_time);
+	printf("   p after AutoTune():                  %12.3f\n", ln_capped.P());
 
-	for (unsigned i = 0; i < lists.size(); ++i)
+	// thread scaling, the same mixed workload split over more and more threads
+	const unsigned max_threads = std::min(std::max(std::thread::hardware_concurrency(), 4u), 16u);
+	std::uniform_int_distribution<unsigned long long> key_distribution(0, 2 * n_existing);
+	std::vector<unsigned long long> operations(4 * n);
+	for (auto& operation : operations) operation = key_distribution(g);
+
+	// every 10th operation inserts, every 10th removes, the rest are Contains()
+	const auto run_threads = [&](unsigned thread_count, const std::function<void(size_t, unsigned long long)>& apply)
 	{
-		auto& list = lists[i];
-		auto& result = results[i];
-	
-		result.contains_time =  time(
-			"\n  Testing Contains() for " + list->GetName(),
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < thread_count; ++t)
+			threads.emplace_back([&, t]
+			{
+				for (size_t i = t * operations.size() / thread_count; i < (t + 1) * operations.size() / thread_count; ++i)
+					apply(i, operations[i]);
+			});
+		for (auto& thread : threads) thread.join();
+	};
+
+	std::cout << "\n Testing thread scaling on " << operations.size() << " operations (10% Insert(), 10% Remove(), 80% Contains())." << std::endl;
+	std::vector<std::pair<unsigned long long, unsigned long long>> scaling_times;
+	for (unsigned thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+	{
+		std::unique_ptr<concurrent_skip_list<test_class>> concurrent;
+		const auto concurrent_time = time(
+			"\n  Testing " + std::to_string(thread_count) + " threads for concurrent skip list",
 			[&]
 			{
-				// shuffle input
-				std::shuffle(input.begin(), input.end(), g);
+				concurrent = std::make_unique<concurrent_skip_list<test_class>>();
+				for (long long i = 0; i < n_existing; i += 2) concurrent->Insert(i);
 			},
-			[&]()
+			[&]
+			{
+				run_threads(thread_count, [&](size_t i, unsigned long long key)
+				{
+					if (i % 10 == 0) concurrent->Insert(key);
+					else if (i % 10 == 1) concurrent->Remove(key);
+					else concurrent->Contains(key);
+				});
+			},
+			repetitions);
+
+		::skip_list<test_class> locked;
+		std::mutex mutex;
+		const auto locked_time = time(
+			"\n  Testing " + std::to_string(thread_count) + " threads for skip list behind a mutex",
+			[&]
+			{
+				locked.Clear();
+				for (long long i = 0; i < n_existing; i += 2) locked.Insert(i);
+			},
+			[&]
 			{
-				// call Contains() on list with all inputs
-				containsList(input, *list);
+				run_threads(thread_count, [&](size_t i, unsigned long long key)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (i % 10 == 0) locked.Insert(key);
+					else if (i % 10 == 1) locked.Remove(key);
+					else locked.Contains(key);
+				});
 			},
 			repetitions);
+
+		scaling_times.emplace_back(concurrent_time, locked_time);
 	}
 
-	std::cout << "\n\n Contains() Results (ms = microseconds):\n" << std::endl;
-	std::cout << "                     ";
-	for (const auto& result : results) printf("%20s", result.list_name.c_str());
-	std::cout << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.contains_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].contains_time) / static_cast<double>(results[0].contains_time) - 100);
-	std::cout << std::endl;
+	std::cout << "\n Thread scaling results for " << operations.size() << " operations (ms = microseconds):" << std::endl;
+	std::cout << "   Threads   concurrent skip list   speed up   skip list with mutex   speed up" << std::endl;
+	for (unsigned i = 0; i < scaling_times.size(); ++i)
+		printf("   %7u %19lld ms %9.2fx %19lld ms %9.2fx\n", 1u << i,
+			scaling_times[i].first, static_cast<double>(scaling_times[0].first) / static_cast<double>(scaling_times[i].first),
+			scaling_times[i].second, static_cast<double>(scaling_times[0].second) / static_cast<double>(scaling_times[i].second));
+
+	// readers against one writer that keeps inserting and removing, readers only time their own lookups
+	const auto run_readers = [&](unsigned reader_count, const std::function<void(unsigned long long)>& read,
+	                             const std::function<void(unsigned long long, bool)>& write)
+	{
+		std::atomic<unsigned> readers_left(reader_count);
+		std::thread writer([&]
+		{
+			for (size_t i = 0; readers_left.load(std::memory_order_relaxed); i = (i + 1) % operations.size())
+				write(operations[i] | 1, i % 2 == 0);
+		});
+		std::vector<std::thread> readers;
+		for (unsigned t = 0; t < reader_count; ++t)
+			readers.emplace_back([&]
+			{
+				for (const auto key : operations) read(key);
+				--readers_left;
+			});
+		for (auto& reader : readers) reader.join();
+		writer.join();
+	};
+
+	std::cout << "\n Testing readers doing " << operations.size() << " Contains() each with one writer running." << std::endl;
+	std::vector<std::pair<unsigned long long, unsigned long long>> reader_times;
+	for (unsigned reader_count = 1; reader_count <= max_threads; reader_count *= 2)
+	{
+		single_writer_skip_list<test_class> single_writer;
+		const auto single_writer_time = time(
+			"\n  Testing " + std::to_string(reader_count) + " readers for single writer skip list",
+			[&]
+			{
+				single_writer.Clear();
+				for (long long i = 0; i < n_existing; i += 2) single_writer.Insert(i);
+			},
+			[&]
+			{
+				run_readers(reader_count,
+					[&](unsigned long long key) { single_writer.Contains(key); },
+					[&](unsigned long long key, bool insert) { if (insert) single_writer.Insert(key); else single_writer.Remove(key); });
+			},
+			repetitions);
+
+		::skip_list<test_class> shared;
+		std::shared_mutex shared_mutex;
+		const auto shared_time = time(
+			"\n  Testing " + std::to_string(reader_count) + " readers for skip list behind a shared_mutex",
+			[&]
+			{
+				shared.Clear();
+				for (long long i = 0; i < n_existing; i += 2) shared.Insert(i);
+			},
+			[&]
+			{
+				run_readers(reader_count,
+					[&](unsigned long long key) { std::shared_lock<std::shared_mutex> lock(shared_mutex); shared.Contains(key); },
+					[&](unsigned long long key, bool insert)
+					{
+						std::unique_lock<std::shared_mutex> lock(shared_mutex);
+						if (insert) shared.Insert(key);
+						else shared.Remove(key);
+					});
+			},
+			repetitions);
+
+		reader_times.emplace_back(single_writer_time, shared_time);
+	}
+
+	std::cout << "\n Reader results for " << operations.size() << " Contains() per reader (ms = microseconds):" << std::endl;
+	std::cout << "   Readers   single writer skip list    reads/s   skip list with shared_mutex    reads/s" << std::endl;
+	for (unsigned i = 0; i < reader_times.size(); ++i)
+		printf("   %7u %22lld ms %10.0f %26lld ms %10.0f\n", 1u << i,
+			reader_times[i].first, 1000000.0 * static_cast<double>(operations.size() << i) / static_cast<double>(reader_times[i].first),
+			reader_times[i].second, 1000000.0 * static_cast<double>(operations.size() << i) / static_cast<double>(reader_times[i].second));
+
+	// batches, the sharded list routes each batch to its shards and applies them on a pool of max_threads - 1 workers
+	std::vector<sharded_skip_list_op<test_class>> insert_batch;
+	std::vector<sharded_skip_list_op<test_class>> remove_batch;
+	for (const auto key : operations) insert_batch.push_back({ sharded_skip_list_op<test_class>::insert, key });
+	for (const auto key : operations) remove_batch.push_back({ sharded_skip_list_op<test_class>::remove, key });
+
+	sharded_skip_list<test_class> sharded(max_threads, max_threads - 1);
+	std::cout << "\n Testing batches of " << operations.size() << " operations for sharded skip list with " << sharded.Shards() << " shards." << std::endl;
+	const auto batch_insert_time = time(
+		"\n  Testing Apply() of an insert batch for sharded skip list",
+		[&] { sharded.Clear(); },
+		[&] { sharded.Apply(insert_batch); },
+		repetitions);
+
+	const auto batch_remove_time = time(
+		"\n  Testing Apply() of a remove batch for sharded skip list",
+		[&] { sharded.Clear(); sharded.Apply(insert_batch); },
+		[&] { sharded.Apply(remove_batch); },
+		repetitions);
+
+	::skip_list<test_class> unsharded;
+	const auto single_insert_time = time(
+		"\n  Testing Insert() per key for skip list",
+		[&] { unsharded.Clear(); },
+		[&] { for (const auto key : operations) unsharded.Insert(key); },
+		repetitions);
+
+	const auto single_remove_time = time(
+		"\n  Testing Remove() per key for skip list",
+		[&] { unsharded.Clear(); for (const auto key : operations) unsharded.Insert(key); },
+		[&] { for (const auto key : operations) unsharded.Remove(key); },
+		repetitions);
+
+	std::cout << "\n Batch results for " << operations.size() << " operations (ms = microseconds):" << std::endl;
+	printf("   Insert batch, sharded skip list:     %12lld ms\n", batch_insert_time);
+	printf("   Insert() per key, skip list:         %12lld ms\n", single_insert_time);
+	printf("   Remove batch, sharded skip list:     %12lld ms\n", batch_remove_time);
+	printf("   Remove() per key, skip list:         %12lld ms\n", single_remove_time);
+
+	// consistent scans of the whole list while a writer keeps inserting and removing, counting the writes done meanwhile
+	const auto run_scan = [&](const std::function<void()>& scan, const std::function<void(unsigned long long, bool)>& write)
+	{
+		std::atomic<bool> scanning(true);
+		unsigned long long writes = 0;
+		std::thread writer([&]
+		{
+			for (size_t i = 0; scanning.load(std::memory_order_relaxed); i = (i + 1) % operations.size(), ++writes)
+				write(operations[i] | 1, i % 2 == 0);
+		});
+		scan();
+		scanning = false;
+		writer.join();
+		return writes;
+	};
+
+	versioned_skip_list<test_class> versioned;
+	for (long long i = 0; i < n_existing; i += 2) versioned.Insert(i);
+	std::cout << "\n Testing consistent scans of " << versioned.Size() << " elements with one writer running." << std::endl;
+	unsigned long long versioned_writes = 0;
+	const auto versioned_scan_time = time(
+		"\n  Testing Snapshot() and scan for versioned skip list",
+		[] {},
+		[&]
+		{
+			versioned_writes += run_scan(
+				[&]
+				{
+					const auto snapshot = versioned.Snapshot();
+					for (const auto& val : snapshot) (void)val;
+				},
+				[&](unsigned long long key, bool insert) { if (insert) versioned.Insert(key); else versioned.Remove(key); });
+		},
+		repetitions);
+
+	::skip_list<test_class> copied;
+	for (long long i = 0; i < n_existing; i += 2) copied.Insert(i);
+	std::mutex copied_mutex;
+	unsigned long long copied_writes = 0;
+	const auto copied_scan_time = time(
+		"\n  Testing copy under a mutex and scan for skip list",
+		[] {},
+		[&]
+		{
+			copied_writes += run_scan(
+				[&]
+				{
+					std::unique_lock<std::mutex> lock(copied_mutex);
+					const ::skip_list<test_class> copy(copied);
+					lock.unlock();
+					for (const auto& val : copy) (void)val;
+				},
+				[&](unsigned long long key, bool insert)
+				{
+					std::lock_guard<std::mutex> lock(copied_mutex);
+					if (insert) copied.Insert(key);
+					else copied.Remove(key);
+				});
+		},
+		repetitions);
+
+	std::cout << "\n Consistent scan results (ms = microseconds):" << std::endl;
+	std::cout << "                                            Scan time   Writes during scan" << std::endl;
+	printf("   Snapshot() of versioned skip list: %15lld ms %20llu\n", versioned_scan_time, versioned_writes / repetitions);
+	printf("   Copy of skip list under a mutex:   %15lld ms %20llu\n", copied_scan_time, copied_writes / repetitions);
+
 
-	
 	
 	std::cout <<"\n -----------------------------------------------------------------------------------------------------" << std::endl;
 	std::cout << "\n Performance results for " << n << " method calls for";
-	for (const auto list : lists) std::cout << " { " << list->GetName() << " }";
+	for (const auto& result : timed[0]) std::cout << " { " << result.name << " }";
 	std::cout << ":\n" << std::endl;
     
 	std::cout << " ms = microseconds" << std::endl;
 	std::cout << "                     ";
-	for (const auto& result : results) printf("%20s", result.list_name.c_str());
-	std::cout << std::endl;
-	
-	std::cout << " Insert():" << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.insert_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].insert_time) / static_cast<double>(results[0].insert_time) - 100);
+	for (const auto& result : timed[0]) printf("%20s", result.name.c_str());
 	std::cout << std::endl;
 
-	std::cout << "\n Remove():" << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.remove_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].remove_time) / static_cast<double>(results[0].remove_time) - 100);
-	std::cout << std::endl;
-	
-	std::cout << "\n Contains():" << std::endl;
-	std::cout << " Execution Time      ";
-	for (const auto& result : results) printf("%17lld ms", result.contains_time);
-	std::cout << std::endl;
-	std::cout << " Skip List Speed Up %";
-	for (unsigned i = 0; i < results.size(); ++i)
-		printf("%19.2f%%", 100 * static_cast<double>(results[i].contains_time) / static_cast<double>(results[0].contains_time) - 100);
-	std::cout << std::endl;
+	for (unsigned i = 0; i < timed.size(); ++i)
+	{
+		std::cout << (i ? "\n " : " ") << benchmark_call_name(benchmark_operations()[i]) << ":" << std::endl;
+		print_times(timed[i]);
+	}
 	
 	std::cout << "\n *Skip List Speed Up % = 100 * (List Execution Time) / (Skip List Execution Time) - 100" << std::endl;
 }
@@ -450,12 +1094,15 @@ void run_correctness_test()
 	std::shuffle(input.begin(), input.end(), g);
 	
 	skip_list_test<unsigned long long> skip_list;
+	skip_list_test<unsigned long long, skip_list_pool_allocator<unsigned long long>> pooled_skip_list(0.5, "pooled skip list");
+	blocked_skip_list_test<unsigned long long, 8> blocked_skip_list;
 	sorted_linked_list<unsigned long long> linked_list;
 	sorted_vector<unsigned long long> vector_list;
 
-	const std::vector<sorted_list<unsigned long long>*> lists { &skip_list, &linked_list, &vector_list };
+	const std::vector<sorted_list<unsigned long long>*> lists
+		{ &skip_list, &pooled_skip_list, &blocked_skip_list, &linked_list, &vector_list };
 	
-	std::cout << " - checking if skip list, sorted linked list, and sorted vector list remain sorted and equivalent" <<
+	std::cout << " - checking if skip lists, sorted linked list, and sorted vector list remain sorted and equivalent" <<
         "\n   with correct size after Insert():";
     
 	for (const auto i : input)
@@ -481,7 +1128,7 @@ void run_correctness_test()
 	std::cout << "\n   Passed!\n" << std::endl;
 	
 
-	std::cout << " - checking if skip list, sorted linked list, and sorted vector list remain sorted and equivalent" <<
+	std::cout << " - checking if skip lists, sorted linked list, and sorted vector list remain sorted and equivalent" <<
         "\n   with correct size after Remove() (no misses):";
     
 	for (const auto i : input)
@@ -512,7 +1159,7 @@ void run_correctness_test()
 	
 	constexpr auto n_half = n>>1;
 	
-	std::cout << " - checking if skip list, sorted linked list, and sorted vector list return the same response" <<
+	std::cout << " - checking if skip lists, sorted linked list, and sorted vector list return the same response" <<
         "\n   for Contains() (50% misses):";
     
 	for (const auto i : input)
@@ -532,7 +1179,7 @@ void run_correctness_test()
 	std::cout << "\n   Passed!\n" << std::endl;
 
 	
-	std::cout << " - checking if skip list, sorted linked list, and sorted vector list remain sorted and equivalent" <<
+	std::cout << " - checking if skip lists, sorted linked list, and sorted vector list remain sorted and equivalent" <<
         "\n   with correct size after Remove() (50% misses):";
     
 	for (const auto i : input)
@@ -556,6 +1203,1346 @@ void run_correctness_test()
 	}
 	std::cout << "\n   Passed!\n" << std::endl;
 
+
+	std::cout << " - checking if skip lists, sorted linked list, and sorted vector list are empty after Clear()" <<
+        "\n   and remain equivalent when refilled:";
+
+	for (const auto list : lists)
+	{
+		list->Clear();
+		if (list->Size() != 0 || !list->AsVector().empty())
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     " << list->GetName() << " not empty after Clear()!" << std::endl;
+			return;
+		}
+		insertList(input, *list);
+		if (!isSorted(*list)) return;
+	}
+	if (!equal(lists)) return;
+
+	// lists built from one allocator share its pool, clearing one must leave the other's nodes alone
+	{
+		typedef skip_list_pool_allocator<unsigned long long> allocator;
+		allocator shared;
+		::skip_list<unsigned long long, std::less<unsigned long long>, allocator> x(0.5, {}, shared), y(0.5, {}, shared);
+		for (const auto i : input)
+		{
+			x.Insert(i);
+			y.Insert(i);
+		}
+		x.Clear();
+		for (const auto i : input) x.Insert(n + i);
+		bool failed = shared.BlocksInUse() != 2 * input.size();
+		for (const auto i : input) if (!y.Contains(i) || !x.Contains(n + i)) failed = true;
+
+		// once y is the only list left in the pool it is released at once
+		x.Clear();
+		y.Clear();
+		if (failed || shared.BlocksInUse() != 0 || shared.Pool().BytesReserved() != 0)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip lists sharing a pool lost elements after Clear()!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if skip lists built from sorted input with sorted_tag and AssignSorted() are sorted," <<
+        "\n   have evenly spaced layers, and stay correct after Insert() and Remove():";
+
+	std::vector<unsigned long long> sorted_input;
+	for (const auto i : input) sorted_input.push_back(i / 2);
+	std::sort(sorted_input.begin(), sorted_input.end());
+
+	for (const float p : { 0.5f, 0.25f })
+	{
+		::skip_list<unsigned long long> bulk(sorted_input.begin(), sorted_input.end(), sorted_tag, p), rebuilt(p);
+		rebuilt.AssignSorted(sorted_input.begin(), sorted_input.end());
+
+		// every 1/p-th element is promoted, so the average height is close to the expected 1 / (1 - p)
+		const double expected_height = 1 / (1 - static_cast<double>(p));
+		if (bulk.Size() != sorted_input.size() || !std::equal(bulk.begin(), bulk.end(), sorted_input.begin()) ||
+			bulk.MemoryUsage() != rebuilt.MemoryUsage() || std::abs(bulk.AverageHeight() - expected_height) > 0.05 * expected_height)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list built from sorted input for p = " << p << " is invalid!" << std::endl;
+			return;
+		}
+
+		std::vector<unsigned long long> expected_bulk(sorted_input);
+		for (unsigned long long i = 0; i < n / 2; i += 3)
+		{
+			bulk.Insert(i);
+			expected_bulk.insert(std::upper_bound(expected_bulk.begin(), expected_bulk.end(), i), i);
+			if (i % 2 && bulk.Remove(i + 1)) expected_bulk.erase(std::lower_bound(expected_bulk.begin(), expected_bulk.end(), i + 1));
+		}
+		if (bulk.Size() != expected_bulk.size() || !std::equal(bulk.begin(), bulk.end(), expected_bulk.begin()))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list built from sorted input invalid after Insert() and Remove()!" << std::endl;
+			return;
+		}
+	}
+
+	// single pass input iterators are counted as they are read
+	std::istringstream stream("1 2 2 3 5 8");
+	::skip_list<unsigned long long> streamed;
+	streamed.AssignSorted(std::istream_iterator<unsigned long long>(stream), std::istream_iterator<unsigned long long>());
+	if (streamed.Size() != 6 || *streamed.LowerBound(4) != 5 || streamed.EraseRange(2, 3) != 2)
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     skip list assigned from an input iterator is invalid!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if the SIMD kernels count the same keys as std::lower_bound and std::upper_bound, with" <<
+        "\n   and without AVX2, and if blocked skip lists searching their blocks with them match a std::multiset:";
+
+	{
+		bool failed = false;
+		const auto check = [&](auto block)
+		{
+			typedef typename decltype(block)::value_type key;
+
+			// every length up to a few vectors leaves each possible tail, and every stored key is searched for along
+			// with the keys around it
+			for (unsigned n = 0; n <= block.size(); ++n)
+			{
+				for (unsigned i = 0; i < block.size(); ++i)
+				{
+					const auto lower = static_cast<unsigned>(std::lower_bound(block.begin(), block.begin() + n, block[i]) - block.begin());
+					const auto upper = static_cast<unsigned>(std::upper_bound(block.begin(), block.begin() + n, block[i]) - block.begin());
+					if (skip_list_simd::CountLess(block.data(), n, block[i]) != lower ||
+						skip_list_simd::CountLessEqual(block.data(), n, block[i]) != upper)
+						failed = true;
+				}
+				for (const key k : { std::numeric_limits<key>::lowest(), key(0), std::numeric_limits<key>::max() })
+					if (skip_list_simd::CountLess(block.data(), n, k) != static_cast<unsigned>(std::lower_bound(block.begin(), block.begin() + n, k) - block.begin()) ||
+						skip_list_simd::CountLessEqual(block.data(), n, k) != static_cast<unsigned>(std::upper_bound(block.begin(), block.begin() + n, k) - block.begin()))
+						failed = true;
+			}
+		};
+		const auto run = [&]
+		{
+			// unsigned keys on both sides of the top bit go through the sign bias
+			std::vector<std::uint64_t> u64;
+			for (std::uint64_t i = 0; i < 19; ++i) u64.push_back(i * (std::numeric_limits<std::uint64_t>::max() / 18) - i % 3);
+			std::sort(u64.begin(), u64.end());
+			check(u64);
+
+			std::vector<std::int64_t> i64;
+			for (std::int64_t i = -9; i < 10; ++i) i64.push_back(i * (std::numeric_limits<std::int64_t>::max() / 10) + i % 2);
+			std::sort(i64.begin(), i64.end());
+			check(i64);
+
+			std::vector<std::uint32_t> u32;
+			for (std::uint32_t i = 0; i < 21; ++i) u32.push_back(i / 2 * (std::numeric_limits<std::uint32_t>::max() / 10));
+			check(u32);
+
+			std::vector<float> f32;
+			for (int i = -10; i < 11; ++i) f32.push_back(static_cast<float>(i / 2) * 0.75f);
+			check(f32);
+		};
+		run();
+		skip_list_simd::force_sse = true;
+		run();
+		skip_list_simd::force_sse = false;
+
+		// duplicates span blocks, unsigned keys use the top bit and float keys are negative too
+		std::mt19937_64 random(n);
+		::blocked_skip_list<std::uint64_t, 4> blocked(0.5, 3);
+		::blocked_skip_list<float, 4> blocked_float(0.25, 3);
+		std::multiset<std::uint64_t> expected;
+		std::multiset<float> expected_float;
+		for (int i = 0; i < 20 * n; ++i)
+		{
+			const auto key = (random() % (n / 4)) * (std::numeric_limits<std::uint64_t>::max() / (n / 4));
+			const auto key_float = static_cast<float>(random() % (n / 4)) - n / 8;
+			if (random() % 3)
+			{
+				blocked.Insert(key);
+				expected.insert(key);
+				blocked_float.Insert(key_float);
+				expected_float.insert(key_float);
+			}
+			else
+			{
+				const auto found = expected.find(key);
+				if (blocked.Remove(key) != (found != expected.end())) failed = true;
+				if (found != expected.end()) expected.erase(found);
+				const auto found_float = expected_float.find(key_float);
+				if (blocked_float.Remove(key_float) != (found_float != expected_float.end())) failed = true;
+				if (found_float != expected_float.end()) expected_float.erase(found_float);
+			}
+			if (blocked.Contains(key) != (expected.count(key) != 0) || blocked_float.Contains(key_float) != (expected_float.count(key_float) != 0))
+				failed = true;
+		}
+		if (blocked.Size() != expected.size() || !std::equal(expected.begin(), expected.end(), blocked.begin(), blocked.end()) ||
+			blocked_float.Size() != expected_float.size() ||
+			!std::equal(expected_float.begin(), expected_float.end(), blocked_float.begin(), blocked_float.end()) ||
+			blocked.Contains(std::numeric_limits<std::uint64_t>::max()) != (expected.count(std::numeric_limits<std::uint64_t>::max()) != 0))
+			failed = true;
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     SIMD search counts or blocked skip list differ from the std algorithms!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if skip lists built with the same seed have the same structure and tower heights" <<
+        "\n   follow p:";
+
+	for (const float p : { 0.5f, 0.25f, 0.3f })
+	{
+		::skip_list<unsigned long long> unseeded(p), seeded_a(p, 42), seeded_b(p, 42);
+		for (const auto i : input)
+		{
+			unseeded.Insert(i);
+			seeded_a.Insert(i);
+			seeded_b.Insert(i);
+		}
+
+		if (seeded_a.MemoryUsage() != seeded_b.MemoryUsage() || seeded_a.AverageHeight() != seeded_b.AverageHeight())
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip lists with the same seed have different structures!" << std::endl;
+			return;
+		}
+
+		// expected height of a geometric distribution is 1 / (1 - p)
+		const double expected = 1 / (1 - static_cast<double>(p));
+		if (std::abs(unseeded.AverageHeight() - expected) > 0.15 * expected)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     average tower height " << unseeded.AverageHeight() << " for p = " << p <<
+				" expected " << expected << "!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if copies of skip lists have the same elements and structure, and copy-on-write" <<
+        "\n   snapshots don't see later writes:";
+
+	{
+		::skip_list<unsigned long long> original;
+		indexed_skip_list<unsigned long long> original_indexed;
+		for (const auto i : input)
+		{
+			original.Insert(i / 3);
+			original_indexed.Insert(i / 3);
+		}
+
+		const ::skip_list<unsigned long long> copied(original);
+		const indexed_skip_list<unsigned long long> copied_indexed(original_indexed);
+		::skip_list<unsigned long long> assigned;
+		assigned.Insert(n);
+		assigned = original;
+		for (const auto* copy : { &copied, static_cast<const ::skip_list<unsigned long long>*>(&assigned) })
+		{
+			if (copy->Size() != original.Size() || !std::equal(original.begin(), original.end(), copy->begin(), copy->end()) ||
+				copy->MemoryUsage() != original.MemoryUsage() || copy->AverageHeight() != original.AverageHeight())
+			{
+				std::cout << "   Fail!" << std::endl;
+				std::cout << "     copied skip list differs from the original!" << std::endl;
+				return;
+			}
+		}
+		for (size_t k = 0; k < copied_indexed.Size(); k += 7)
+		{
+			if (copied_indexed.At(k) != original_indexed.At(k) || copied_indexed.Rank(k) != original_indexed.Rank(k))
+			{
+				std::cout << "   Fail!" << std::endl;
+				std::cout << "     copied indexed skip list has different positions!" << std::endl;
+				return;
+			}
+		}
+
+		cow_skip_list<unsigned long long> cow;
+		std::vector<unsigned long long> expected_cow;
+		for (int i = 0; i < n; ++i)
+		{
+			cow.Insert(i);
+			expected_cow.push_back(i);
+		}
+		const auto snapshot = cow.Snapshot();
+		const bool shared = cow.Shared() && &snapshot.Get() == &cow.Get();
+		for (const auto i : input)
+			if (i % 2) cow.Remove(i);
+		cow.Insert(n);
+		if (!shared || cow.Shared() || snapshot.Shared() || snapshot.Size() != expected_cow.size() || cow.Size() != expected_cow.size() / 2 + 1 ||
+			!std::equal(snapshot.begin(), snapshot.end(), expected_cow.begin(), expected_cow.end()) || !cow.Contains(n) || cow.Contains(1))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     copy-on-write snapshot changed or wasn't shared!" << std::endl;
+			return;
+		}
+
+		// sharing turns off the features that write on reads, singly linked lists can be shared too
+		cow_skip_list<unsigned long long, std::less<unsigned long long>, std::allocator<unsigned long long>,
+			skip_list_level_generator, skip_list_unindexed, skip_list_singly_linked> singly;
+		for (const auto i : input) singly.Insert(i);
+		singly.Mutable().UseFinger(true);
+		singly.Mutable().AutoTune(true);
+		const auto singly_snapshot = singly.Snapshot();
+		if (singly_snapshot.Get().UsesFinger() || singly_snapshot.Get().AutoTunes() || !singly.Shared() ||
+			!singly_snapshot.Contains(input.front()) || singly_snapshot.Size() != input.size())
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     shared copy-on-write list still searches from a finger or tunes itself!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if a skip list saved with Save() and opened as a mapped_skip_list has the same elements," <<
+        "\n   finds the same keys, and rejects files that are damaged or hold another type:";
+
+	{
+		const auto path = (std::filesystem::temp_directory_path() / "skip_list_test.bin").string();
+		::skip_list<unsigned long long> saved;
+		for (const auto i : input) saved.Insert(2 * (i / 2));
+		saved.Save(path);
+
+		bool failed = false;
+		{
+			const mapped_skip_list<unsigned long long> mapped(path);
+			if (!mapped.Verify() || mapped.Size() != saved.Size() || !std::equal(saved.begin(), saved.end(), mapped.begin(), mapped.end()))
+				failed = true;
+			for (unsigned long long i = 0; i <= input.size(); ++i)
+			{
+				const auto lower = saved.LowerBound(i);
+				const auto mapped_lower = mapped.LowerBound(i);
+				if (mapped.Contains(i) != saved.Contains(i) || (mapped.Find(i) != mapped.end()) != saved.Contains(i) ||
+					(lower == saved.end()) != (mapped_lower == mapped.end()) || (lower != saved.end() && *lower != *mapped_lower) ||
+					std::distance(mapped.LowerBound(i), mapped.UpperBound(i)) != std::distance(saved.LowerBound(i), saved.UpperBound(i)))
+					failed = true;
+			}
+		}
+
+		// a flipped byte in the body fails Verify(), one in the header fails opening, and so does another element type
+		{
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			file.seekp(-1, std::ios::end);
+			file.put('\xff');
+		}
+		if (mapped_skip_list<unsigned long long>(path).Verify()) failed = true;
+		const auto rejects = [&](auto&& open) { try { open(); } catch (const std::runtime_error&) { return true; } return false; };
+		if (!rejects([&] { mapped_skip_list<unsigned int> wrong_type(path); })) failed = true;
+		{
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			file.seekp(20);
+			file.put('\xff');
+		}
+		if (!rejects([&] { mapped_skip_list<unsigned long long> damaged(path); })) failed = true;
+
+		::skip_list<unsigned long long>().Save(path);
+		{
+			const mapped_skip_list<unsigned long long> empty(path);
+			if (empty.Size() != 0 || empty.begin() != empty.end() || empty.Contains(0) || !empty.Verify()) failed = true;
+		}
+		std::filesystem::remove(path);
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     mapped_skip_list and the saved skip list differ, or a bad file was accepted!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if Emplace() and Insert() with moved elements keep a skip list of strings sorted:";
+
+	::skip_list<std::string> strings;
+	for (const auto i : input)
+	{
+		if (i % 2) strings.Emplace(i % 26 + 1, static_cast<char>('a' + i % 26));
+		else strings.Insert(std::to_string(i));
+	}
+	std::string previous;
+	for (const auto& string : strings)
+	{
+		if (string < previous)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list of strings order invalid!" << std::endl;
+			return;
+		}
+		previous = string;
+	}
+	if (strings.Size() != input.size() || !strings.Contains("zzzzzzzzzzzzzzzzzzzzzzzzzz") || !strings.Remove("0"))
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     skip list of strings missing elements!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if a skip list with a custom Compare keeps its order, and transparent lookups with" <<
+        "\n   std::string_view find strings without allocating:";
+
+	::skip_list<unsigned long long, std::greater<unsigned long long>> descending;
+	for (const auto i : input) descending.Insert(i);
+	unsigned long long expected = n;
+	for (const auto i : descending)
+	{
+		if (i != --expected)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     descending skip list order invalid!" << std::endl;
+			return;
+		}
+	}
+
+	::skip_list<std::string, std::less<>> transparent;
+	for (const auto i : input) transparent.Insert("key " + std::to_string(i) + " with a long enough suffix to allocate");
+	const auto allocations = allocation_count.load();
+	const std::string_view present = "key 7 with a long enough suffix to allocate";
+	const std::string_view missing = "key 7";
+	const bool found = transparent.Contains(present) && transparent.Find(present) != transparent.end() &&
+		!transparent.Contains(missing);
+	if (!found || allocation_count.load() != allocations || !transparent.Remove(present) || transparent.Contains(present))
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     transparent lookup with std::string_view failed or allocated!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if LowerBound(), UpperBound(), EqualRange(), and EraseRange() match the sorted vector" <<
+        "\n   bounds on a skip list with duplicates:";
+
+	::skip_list<unsigned long long> ranges;
+	std::vector<unsigned long long> expected_ranges;
+	for (const auto i : input)
+	{
+		ranges.Insert(i / 4);
+		expected_ranges.push_back(i / 4);
+	}
+	std::sort(expected_ranges.begin(), expected_ranges.end());
+
+	std::uniform_int_distribution<unsigned long long> key_distribution(0, n / 4 + 1);
+	for (int i = 0; i < 100; ++i)
+	{
+		const auto lo = key_distribution(g);
+		const auto hi = lo + key_distribution(g) / 8;
+
+		const auto lower = std::lower_bound(expected_ranges.begin(), expected_ranges.end(), lo);
+		const auto upper = std::upper_bound(expected_ranges.begin(), expected_ranges.end(), lo);
+		const auto equal_range = ranges.EqualRange(lo);
+		const bool bounds_match =
+			(lower == expected_ranges.end() ? ranges.LowerBound(lo) == ranges.end() : *ranges.LowerBound(lo) == *lower) &&
+			(upper == expected_ranges.end() ? ranges.UpperBound(lo) == ranges.end() : *ranges.UpperBound(lo) == *upper) &&
+			std::distance(equal_range.first, equal_range.second) == std::distance(lower, upper);
+
+		const auto erase_begin = lower;
+		const auto erase_end = std::lower_bound(expected_ranges.begin(), expected_ranges.end(), hi);
+		const auto removed = static_cast<size_t>(std::distance(erase_begin, erase_end));
+		expected_ranges.erase(erase_begin, erase_end);
+
+		if (!bounds_match || ranges.EraseRange(lo, hi) != removed || ranges.Size() != expected_ranges.size() ||
+			!std::equal(ranges.begin(), ranges.end(), expected_ranges.begin()))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     range query or EraseRange(" << lo << ", " << hi << ") doesn't match sorted vector!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if hinted Insert(), Find(), LowerBound(), and searches from the last finger match the" <<
+        "\n   sorted vector:";
+
+	::skip_list<unsigned long long> fingered;
+	fingered.UseFinger(true);
+	std::vector<unsigned long long> expected_fingered;
+	auto hint = fingered.begin();
+	for (const auto i : input)
+	{
+		// keys cluster around i, hints are a little before the key
+		const auto k = i / 8 * 8 + i % 3;
+		if (i % 2) hint = fingered.Insert(fingered.LowerBound(hint, k > 8 ? k - 8 : 0), k);
+		else fingered.Insert(k);
+		expected_fingered.insert(std::upper_bound(expected_fingered.begin(), expected_fingered.end(), k), k);
+
+		if (i % 5 == 0 && fingered.Remove(k + 1))
+			expected_fingered.erase(std::lower_bound(expected_fingered.begin(), expected_fingered.end(), k + 1));
+
+		const auto lower = std::lower_bound(expected_fingered.begin(), expected_fingered.end(), k + 2);
+		const auto found = fingered.LowerBound(hint, k + 2);
+		const bool exists = std::binary_search(expected_fingered.begin(), expected_fingered.end(), k + 2);
+		if ((lower == expected_fingered.end() ? found != fingered.end() : found == fingered.end() || *found != *lower) ||
+			(fingered.Find(hint, k + 2) != fingered.end()) != exists || fingered.Contains(k + 2) != exists)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     hinted or finger search for " << k + 2 << " doesn't match sorted vector!" << std::endl;
+			return;
+		}
+	}
+	if (fingered.Size() != expected_fingered.size() || !std::equal(fingered.begin(), fingered.end(), expected_fingered.begin()))
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     skip list using hints and a finger doesn't match sorted vector!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if an indexed skip list returns the same Rank(), At(), Select(), and CountRange() as the" <<
+        "\n   sorted vector after Insert(), Remove(), EraseAt(), and EraseRange():";
+
+	indexed_skip_list<unsigned long long> indexed;
+	std::vector<unsigned long long> expected_indexed;
+	for (const auto i : input)
+	{
+		const auto k = i / 2;
+		switch (i % 5)
+		{
+		case 0:
+			if (indexed.Remove(k + 1))
+				expected_indexed.erase(std::lower_bound(expected_indexed.begin(), expected_indexed.end(), k + 1));
+			break;
+		case 1:
+			if (!expected_indexed.empty())
+			{
+				const auto position = k % expected_indexed.size();
+				indexed.EraseAt(position);
+				expected_indexed.erase(expected_indexed.begin() + static_cast<long>(position));
+			}
+			break;
+		case 2:
+			if (indexed.EraseRange(k, k + 3) != 0)
+				expected_indexed.erase(std::lower_bound(expected_indexed.begin(), expected_indexed.end(), k),
+					std::lower_bound(expected_indexed.begin(), expected_indexed.end(), k + 3));
+			break;
+		default:
+			indexed.Insert(k);
+			expected_indexed.insert(std::upper_bound(expected_indexed.begin(), expected_indexed.end(), k), k);
+		}
+
+		const auto lower = std::lower_bound(expected_indexed.begin(), expected_indexed.end(), k);
+		const auto upper = std::lower_bound(expected_indexed.begin(), expected_indexed.end(), k + 50);
+		if (indexed.Size() != expected_indexed.size() || indexed.Rank(k) != static_cast<size_t>(lower - expected_indexed.begin()) ||
+			indexed.CountRange(k, k + 50) != static_cast<size_t>(upper - lower) ||
+			(lower != expected_indexed.end() && (indexed.At(lower - expected_indexed.begin()) != *lower ||
+				*indexed.Select(lower - expected_indexed.begin()) != *lower)))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     indexed skip list positions don't match sorted vector at " << k << "!" << std::endl;
+			return;
+		}
+	}
+	bool thrown = false;
+	try { indexed.At(indexed.Size()); }
+	catch (const std::out_of_range&) { thrown = true; }
+	if (!thrown || indexed.Select(indexed.Size()) != indexed.end())
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     indexed skip list doesn't reject positions past the end!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if ContainsBatch() and FindBatch() give the same results as Contains() and Find() one" <<
+        "\n   key at a time, for batches larger and smaller than the group of interleaved searches:";
+
+	std::vector<unsigned long long> queries(input.begin(), input.end());
+	for (int i = 0; i < n; ++i) queries.push_back(n + i % 7);
+	for (const auto count : { queries.size(), size_t(3), size_t(0) })
+	{
+		std::vector<bool> contained(count);
+		std::vector<::skip_list<unsigned long long>::iterator> found(count, fingered.end());
+		std::vector<indexed_skip_list<unsigned long long>::iterator> found_indexed(count, indexed.end());
+		::skip_list<unsigned long long> empty;
+		std::vector<bool> contained_empty(count, true);
+
+		fingered.ContainsBatch(queries.begin(), queries.begin() + count, contained.begin());
+		fingered.FindBatch(queries.begin(), queries.begin() + count, found.begin());
+		indexed.FindBatch(queries.data(), queries.data() + count, found_indexed.data());
+		empty.ContainsBatch(queries.begin(), queries.begin() + count, contained_empty.begin());
+		for (size_t i = 0; i < count; ++i)
+		{
+			// with duplicates Find() may stop at any of the equal elements
+			if (contained[i] != fingered.Contains(queries[i]) || contained_empty[i] ||
+				(found[i] == fingered.end()) != (fingered.Find(queries[i]) == fingered.end()) ||
+				(found[i] != fingered.end() && *found[i] != queries[i]) ||
+				(found_indexed[i] == indexed.end()) != (indexed.Find(queries[i]) == indexed.end()) ||
+				(found_indexed[i] != indexed.end() && *found_indexed[i] != queries[i]))
+			{
+				std::cout << "   Fail!" << std::endl;
+				std::cout << "     batched lookup of " << queries[i] << " differs from single lookup!" << std::endl;
+				return;
+			}
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if Merge(), Union(), Intersect(), and Difference() match std::merge and the std set" <<
+        "\n   algorithms for lists of similar and very different sizes, indexed lists too:";
+
+	{
+		bool failed = false;
+		const auto check = [&](auto empty_list, size_t a_size, size_t b_size)
+		{
+			typedef decltype(empty_list) list;
+			std::vector<unsigned long long> va(input.begin(), input.begin() + a_size);
+			std::vector<unsigned long long> vb(input.end() - b_size, input.end());
+			for (auto& v : va) v /= 4;
+			for (auto& v : vb) v /= 4;
+			list a;
+			list b;
+			for (const auto v : va) a.Insert(v);
+			for (const auto v : vb) b.Insert(v);
+			std::sort(va.begin(), va.end());
+			std::sort(vb.begin(), vb.end());
+
+			const auto matches = [&](const list& result, const std::vector<unsigned long long>& expected)
+			{
+				if (result.Size() != expected.size() || !std::equal(result.begin(), result.end(), expected.begin(), expected.end()))
+					failed = true;
+				if constexpr (std::is_same<list, indexed_skip_list<unsigned long long>>::value)
+					for (size_t k = 0; k < expected.size(); k += 7)
+						if (result.At(k) != expected[k]) failed = true;
+			};
+
+			std::vector<unsigned long long> expected;
+			std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+			matches(a.Union(b), expected);
+			expected.clear();
+			std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+			matches(a.Intersect(b), expected);
+			matches(b.Intersect(a), expected);
+			expected.clear();
+			std::set_difference(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+			matches(a.Difference(b), expected);
+			expected.clear();
+			std::set_difference(vb.begin(), vb.end(), va.begin(), va.end(), std::back_inserter(expected));
+			matches(b.Difference(a), expected);
+
+			// the merged list must stay searchable and removable, with the other one left empty and usable
+			expected.clear();
+			std::merge(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+			a.Merge(std::move(b));
+			matches(a, expected);
+			b.Insert(1);
+			if (b.Size() != 1 || !b.Contains(1)) failed = true;
+			for (const auto v : expected)
+				if (!a.Contains(v) || !a.Remove(v)) failed = true;
+			if (a.Size() != 0 || a.begin() != a.end()) failed = true;
+		};
+
+		for (const auto& sizes : std::vector<std::pair<size_t, size_t>>{ { n / 2, n / 2 }, { n, n / 50 }, { n / 50, n }, { 0, n / 2 }, { n / 2, 0 } })
+		{
+			check(::skip_list<unsigned long long>(), sizes.first, sizes.second);
+			check(indexed_skip_list<unsigned long long>(), sizes.first, sizes.second);
+		}
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     merged or combined skip list differs from the std algorithms!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if Split() leaves the elements before the key and returns the rest, and Join() puts them" <<
+        "\n   back, for keys before, inside, and after the list, indexed and pooled lists too:";
+
+	{
+		bool failed = false;
+		const auto check = [&](auto empty_list)
+		{
+			typedef decltype(empty_list) list;
+			std::vector<unsigned long long> values(input.begin(), input.end());
+			for (auto& v : values) v /= 3;
+			list whole;
+			for (const auto v : values) whole.Insert(v);
+			std::sort(values.begin(), values.end());
+
+			for (const unsigned long long key : { 0ull, 1ull, values[values.size() / 3], values.back(), values.back() + 1 })
+			{
+				list before(whole);
+				auto after = before.Split(key);
+				const auto cut = static_cast<size_t>(std::lower_bound(values.begin(), values.end(), key) - values.begin());
+				if (before.Size() != cut || after.Size() != values.size() - cut ||
+					!std::equal(before.begin(), before.end(), values.begin(), values.begin() + cut) ||
+					!std::equal(after.begin(), after.end(), values.begin() + cut, values.end()))
+					failed = true;
+				if constexpr (std::is_same<list, indexed_skip_list<unsigned long long>>::value)
+				{
+					for (size_t k = 0; k < before.Size(); k += 5) if (before.At(k) != values[k]) failed = true;
+					for (size_t k = 0; k < after.Size(); k += 5) if (after.At(k) != values[cut + k]) failed = true;
+				}
+
+				// both halves keep working on their own, then join back into the whole list
+				before.Insert(0);
+				after.Insert(values.back() + 1);
+				if (!before.Remove(0) || !after.Remove(values.back() + 1)) failed = true;
+				before.Join(std::move(after));
+				if (after.Size() != 0 || after.begin() != after.end() || before.Size() != values.size() ||
+					!std::equal(before.begin(), before.end(), values.begin(), values.end()))
+					failed = true;
+				if constexpr (std::is_same<list, indexed_skip_list<unsigned long long>>::value)
+					for (size_t k = 0; k < values.size(); k += 5) if (before.At(k) != values[k] || before.Rank(values[k]) > k) failed = true;
+				for (const auto v : values) if (!before.Remove(v)) failed = true;
+				if (before.Size() != 0) failed = true;
+			}
+		};
+		check(::skip_list<unsigned long long>());
+		check(indexed_skip_list<unsigned long long>());
+		check(::skip_list<unsigned long long, std::less<unsigned long long>, skip_list_pool_allocator<unsigned long long>>());
+		check(::skip_list<unsigned long long, std::less<unsigned long long>, std::allocator<unsigned long long>,
+			skip_list_level_generator, skip_list_unindexed, skip_list_singly_linked>());
+
+		// a list with its own pool can't take over another pool's nodes, Join() copies them
+		typedef ::skip_list<unsigned long long, std::less<unsigned long long>, skip_list_pool_allocator<unsigned long long>> pooled;
+		pooled low;
+		pooled high;
+		for (unsigned long long i = 0; i < 100; ++i)
+		{
+			low.Insert(i);
+			high.Insert(100 + i);
+		}
+		low.Join(std::move(high));
+		high.Insert(5);
+		if (low.Size() != 200 || !std::is_sorted(low.begin(), low.end()) || *low.begin() != 0 || high.Size() != 1)
+			failed = true;
+
+		// a pooled list splits off its towers in place, both sides share the pool and clearing one leaves the other
+		auto upper = low.Split(150);
+		upper.Clear();
+		upper.Insert(300);
+		if (low.Size() != 150 || !std::is_sorted(low.begin(), low.end()) || !low.Contains(149) || low.Contains(150) ||
+			upper.Size() != 1 || !upper.Contains(300))
+			failed = true;
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     split or joined skip list has the wrong elements!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if iterating back from end() visits the elements in reverse order, and Back() and Max() find" <<
+        "\n   the largest, after inserts, removes, and merges, in doubly and singly linked lists:";
+
+	{
+		bool failed = false;
+		const auto check = [&](auto empty_list)
+		{
+			typedef decltype(empty_list) list;
+			list l;
+			if (l.Max() != l.end() || l.rbegin() != l.rend()) failed = true;
+			try { l.Back(); failed = true; }
+			catch (const std::out_of_range&) {}
+
+			// equal elements are stepped over one at a time
+			std::multiset<unsigned long long> expected;
+			for (const auto i : input)
+			{
+				l.Insert(i / 3);
+				expected.insert(i / 3);
+			}
+			for (size_t i = 0; i < input.size(); i += 2)
+			{
+				l.Remove(input[i] / 3);
+				expected.erase(expected.find(input[i] / 3));
+			}
+			list other;
+			for (unsigned long long i = 0; i < 100; ++i)
+			{
+				other.Insert(i * 7);
+				expected.insert(i * 7);
+			}
+			l.Merge(std::move(other));
+
+			if (!std::equal(l.rbegin(), l.rend(), expected.rbegin(), expected.rend()) || l.Back() != *expected.rbegin() ||
+				*l.Max() != *expected.rbegin() || std::next(l.Max()) != l.end() || *std::prev(l.end()) != l.Back())
+				failed = true;
+			for (size_t i = 0; i < input.size(); i += 7)
+			{
+				auto it = l.LowerBound(input[i] / 3);
+				auto expected_it = expected.lower_bound(input[i] / 3);
+				if (expected_it == expected.begin()) { if (it != l.begin()) failed = true; }
+				else if (*--it != *--expected_it || *it-- != *expected_it-- ||
+					(expected_it != expected.begin() && *it != *expected_it)) failed = true;
+			}
+		};
+		check(::skip_list<unsigned long long>());
+		check(indexed_skip_list<unsigned long long>());
+		check(::skip_list<unsigned long long, std::less<unsigned long long>, std::allocator<unsigned long long>,
+			skip_list_level_generator, skip_list_unindexed, skip_list_singly_linked>());
+
+		// dropping the link back saves a pointer in every tower
+		if (sizeof(skip_list_node<unsigned long long, false>) + sizeof(void*) != sizeof(skip_list_node<unsigned long long>))
+			failed = true;
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list iterated backwards has the wrong elements!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if Stats() from the counts kept by TrackStats() matches Stats() from walking the list after" <<
+        "\n   inserts, removes, range erases, merges, splits, joins, copies, and moves:";
+
+	{
+		bool failed = false;
+		const auto check = [&](auto& list)
+		{
+			const auto tracked = list.Stats();
+			list.TrackStats(false);
+			const auto walked = list.Stats();
+			list.TrackStats(true);
+
+			size_t towers = 0;
+			for (const auto count : walked.height_counts) towers += count;
+			if (tracked.size != walked.size || tracked.layer_nodes != walked.layer_nodes ||
+				tracked.height_counts != walked.height_counts || tracked.average_gap != walked.average_gap ||
+				tracked.promotion_ratio != walked.promotion_ratio || tracked.node_bytes != walked.node_bytes ||
+				walked.size != list.Size() || towers != list.Size() || walked.layer_nodes.size() != walked.average_gap.size() ||
+				(list.Size() && walked.layer_nodes.front() != list.Size()) ||
+				walked.node_bytes + walked.layer_bytes != list.MemoryUsage())
+				failed = true;
+		};
+		const auto run = [&](auto empty_list)
+		{
+			typedef decltype(empty_list) list;
+			list l;
+			l.TrackStats(true);
+			check(l);
+			for (const auto i : input) l.Insert(i);
+			check(l);
+			for (size_t i = 0; i < input.size(); i += 3) l.Remove(input[i]);
+			l.EraseRange(n / 4, n / 3);
+			check(l);
+
+			// merged by relinking both lists, then by splicing a small list in, then from the small side
+			list other;
+			for (const auto i : input) other.Insert(i / 2);
+			l.Merge(std::move(other));
+			check(l);
+			for (unsigned long long i = 0; i < 10; ++i) other.Insert(i * 100);
+			l.Merge(std::move(other));
+			check(l);
+			other.Insert(n / 2);
+			other.TrackStats(true);
+			other.Merge(std::move(l));
+			check(other);
+			l = std::move(other);
+			check(l);
+
+			auto upper = l.Split(n / 10);
+			check(l);
+			check(upper);
+			auto top = upper.Split(n - n / 10);
+			check(upper);
+			check(top);
+			l.Join(std::move(upper));
+			l.Join(std::move(top));
+			check(l);
+
+			list copy(l);
+			check(copy);
+			copy.Clear();
+			check(copy);
+			copy.Insert(1);
+			check(copy);
+		};
+		run(::skip_list<unsigned long long>());
+		run(indexed_skip_list<unsigned long long>());
+		run(::skip_list<unsigned long long, std::less<unsigned long long>, skip_list_pool_allocator<unsigned long long>>());
+
+		// the heights of a large list follow p
+		::skip_list<unsigned long long> large(0.25);
+		for (unsigned long long i = 0; i < 100000; ++i) large.Insert(i);
+		const auto stats = large.Stats();
+		if (stats.p != 0.25 || std::abs(stats.promotion_ratio - 0.25) > 0.02 || stats.average_gap[1] < 3.5 || stats.average_gap[1] > 4.5)
+			failed = true;
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list stats don't match the list!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if towers stay under the height cap, if AutoTune() moves p toward max_p for reads and toward" <<
+        "\n   min_p for writes, and if rebuilt layers keep every element:";
+
+	{
+		bool failed = false;
+
+		// exact powers of 1/p get their last layer
+		std::vector<unsigned long long> sorted(input.begin(), input.end());
+		std::sort(sorted.begin(), sorted.end());
+		::skip_list<unsigned long long> even(sorted.begin(), sorted.begin() + 512, sorted_tag, 0.5);
+		::skip_list<unsigned long long> quarter(sorted.begin(), sorted.begin() + 256, sorted_tag, 0.25);
+		if (even.Stats().layer_nodes.size() != 10 || quarter.Stats().layer_nodes.size() != 5) failed = true;
+
+		::skip_list<unsigned long long> capped(0.25);
+		capped.SetHeightCap(3);
+		for (const auto i : input) capped.Insert(i);
+		if (capped.HeightCap() != 3 || capped.Stats().layer_nodes.size() > 3) failed = true;
+
+		// blocked lists cap their block towers the same way
+		::blocked_skip_list<unsigned long long, 2> blocked(0.25, 7);
+		for (const auto i : input) blocked.Insert(i);
+		if (blocked.Layers() > static_cast<size_t>(std::log(static_cast<double>(blocked.Blocks())) / std::log(4.0) + 1e-9) + 1)
+			failed = true;
+
+		// layers built under a low cap make searches long, tuning rebuilds them once the cap is lifted
+		capped.SetHeightCap(0);
+		skip_list_tuning tuning;
+		tuning.window = 256;
+		tuning.sample = 4;
+		capped.AutoTune(true, tuning);
+		for (int round = 0; round < 8; ++round)
+		{
+			for (const auto i : input) capped.Contains(i);
+			capped.Insert(n);
+			capped.Remove(n);
+		}
+		if (!capped.AutoTunes() || capped.P() <= 0.4f || capped.P() > tuning.max_p || capped.Stats().layer_nodes.size() <= 3 ||
+			capped.Stats().layer_nodes[3] < sorted.size() / 32 ||
+			capped.Size() != sorted.size() || !std::equal(capped.begin(), capped.end(), sorted.begin(), sorted.end()))
+			failed = true;
+
+		::skip_list<unsigned long long> written;
+		written.AutoTune(true, tuning);
+		for (const auto i : input) written.Insert(i);
+		for (const auto i : input) written.Remove(i);
+		if (written.P() >= 0.2f || written.P() < tuning.min_p || written.Size() != 0) failed = true;
+
+		// hinted inserts are writes too
+		::skip_list<unsigned long long> hinted;
+		hinted.AutoTune(true, tuning);
+		auto hint = hinted.end();
+		for (const auto i : sorted) hint = hinted.EmplaceHint(hint, i);
+		if (hinted.P() >= 0.2f || hinted.P() < tuning.min_p ||
+			!std::equal(hinted.begin(), hinted.end(), sorted.begin(), sorted.end()))
+			failed = true;
+
+		// rebuilding keeps the elements of indexed and pooled lists in place
+		indexed_skip_list<unsigned long long> indexed(0.25);
+		::skip_list<unsigned long long, std::less<unsigned long long>, skip_list_pool_allocator<unsigned long long>> pooled;
+		for (const auto i : input)
+		{
+			indexed.Insert(i / 2);
+			pooled.Insert(i / 2);
+		}
+		indexed.RebuildLayers();
+		pooled.RebuildLayers();
+		for (size_t k = 0; k < sorted.size(); ++k) if (indexed.At(k) != sorted[k] / 2) failed = true;
+		if (pooled.Size() != sorted.size() || !std::equal(pooled.begin(), pooled.end(), indexed.begin(), indexed.end()))
+			failed = true;
+		pooled.Insert(n);
+		if (!pooled.Remove(n) || !pooled.Contains(sorted.back() / 2)) failed = true;
+
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     skip list height cap or tuning is wrong!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if skip_map matches std::map after try_emplace(), operator[], insert_or_assign(), and" <<
+        "\n   erase(), with each key stored once:";
+
+	::skip_map<unsigned long long, std::string> map;
+	std::map<unsigned long long, std::string> expected_map;
+	for (const auto i : input)
+	{
+		const auto key = i % (n / 2);
+		switch (i % 4)
+		{
+		case 0:
+			if (map.try_emplace(key, 1, 'a').second != expected_map.try_emplace(key, 1, 'a').second) map.clear();
+			break;
+		case 1:
+			map[key] += 'b';
+			expected_map[key] += 'b';
+			break;
+		case 2:
+			if (map.insert_or_assign(key, std::to_string(i)).second != expected_map.insert_or_assign(key, std::to_string(i)).second)
+				map.clear();
+			break;
+		default:
+			if (map.erase(key) != expected_map.erase(key)) map.clear();
+		}
+	}
+	auto expected_entry = expected_map.begin();
+	for (const auto& entry : map)
+	{
+		if (expected_entry == expected_map.end() || entry.first != expected_entry->first || entry.second != expected_entry->second)
+			break;
+		++expected_entry;
+	}
+	if (map.size() != expected_map.size() || expected_entry != expected_map.end() ||
+		map.find(n) != map.end() || map.contains(n))
+	{
+		std::cout << "   Fail!" << std::endl;
+		std::cout << "     skip_map and std::map differ!" << std::endl;
+		return;
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if concurrent_skip_list stays sorted and consistent with threads inserting, removing, and" <<
+        "\n   iterating over the same keys at once:";
+
+	{
+		constexpr unsigned thread_count = 8;
+		constexpr unsigned rounds = 20;
+		concurrent_skip_list<unsigned long long> concurrent;
+		std::atomic<long long> inserted(0);
+		std::atomic<long long> removed(0);
+		std::atomic<bool> failed(false);
+
+		// threads own disjoint keys (i % thread_count == t) to check exact contents, and share keys below n to race
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < thread_count; ++t)
+			threads.emplace_back([&, t]
+			{
+				skip_list_random random(t);
+				for (unsigned round = 0; round < rounds; ++round)
+				{
+					for (auto i = n + t; i < 10 * n; i += thread_count)
+						if (!concurrent.Insert(i)) failed = true;
+					for (auto i = n + t; i < 10 * n; i += 2 * thread_count)
+						if (!concurrent.Remove(i)) failed = true;
+					for (int i = 0; i < n; ++i)
+					{
+						const auto key = random() % n;
+						if (random() & 1) inserted += concurrent.Insert(key);
+						else removed += concurrent.Remove(key);
+					}
+
+					unsigned long long previous = 0;
+					for (const auto val : concurrent)
+					{
+						if (val < previous) failed = true;
+						previous = val + 1;
+					}
+
+					for (auto i = n + t + thread_count; i < 10 * n; i += 2 * thread_count)
+						if (!concurrent.Contains(i) || !concurrent.Remove(i)) failed = true;
+				}
+			});
+		for (auto& thread : threads) thread.join();
+
+		size_t count = 0;
+		for (const auto val : concurrent)
+		{
+			if (val >= static_cast<unsigned long long>(n)) failed = true;
+			++count;
+		}
+		if (failed || count != concurrent.Size() || static_cast<long long>(count) != inserted - removed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     concurrent_skip_list lost, duplicated, or misordered elements!" << std::endl;
+			return;
+		}
+
+		// more lists than a thread caches records for, used in turn so records are evicted and found again, and
+		// replaced by new lists whose ids the stale entries never match
+		for (unsigned generation = 0; generation < 4; ++generation)
+		{
+			std::vector<concurrent_skip_list<unsigned long long>> lists(16);
+			for (int i = 0; i < n; ++i)
+				for (auto& list : lists)
+				{
+					list.Insert(i);
+					if (i % 2) list.Remove(i - 1);
+				}
+			for (const auto& list : lists)
+				if (list.Size() != static_cast<size_t>(n + 1) / 2 || !list.Contains(n - 1)) failed = true;
+		}
+		if (failed)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     concurrent_skip_list lost elements with more lists than cached epoch records!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if single_writer_skip_list readers always find the keys the writer never removes, in order," <<
+        "\n   while the writer inserts and removes other keys:";
+
+	{
+		constexpr unsigned reader_count = 4;
+		single_writer_skip_list<unsigned long long> single_writer;
+		std::multiset<unsigned long long> expected;
+		for (int i = 0; i < n; ++i)
+		{
+			single_writer.Insert(2 * input[i]);
+			expected.insert(2 * input[i]);
+		}
+
+		std::atomic<bool> writing(true);
+		std::atomic<bool> failed(false);
+		std::vector<std::thread> readers;
+		for (unsigned t = 0; t < reader_count; ++t)
+			readers.emplace_back([&, t]
+			{
+				skip_list_random random(t);
+				while (writing)
+				{
+					const auto key = 2 * (random() % n);
+					if (!single_writer.Contains(key) || single_writer.Find(key) == single_writer.end() || *single_writer.Find(key) != key)
+						failed = true;
+
+					unsigned long long previous = 0;
+					size_t stable = 0;
+					for (const auto val : single_writer)
+					{
+						if (val < previous) failed = true;
+						if (val % 2 == 0) ++stable;
+						previous = val;
+					}
+					if (stable != n) failed = true;
+				}
+			});
+
+		skip_list_random random(n);
+		for (int i = 0; i < 100 * n; ++i)
+		{
+			const auto key = 2 * (random() % n) + 1;
+			if (random() & 1)
+			{
+				single_writer.Insert(key);
+				expected.insert(key);
+			}
+			else
+			{
+				const auto it = expected.find(key);
+				if (single_writer.Remove(key) != (it != expected.end())) failed = true;
+				if (it != expected.end()) expected.erase(it);
+			}
+		}
+		writing = false;
+		for (auto& reader : readers) reader.join();
+
+		if (failed || single_writer.Size() != expected.size() || !std::equal(expected.begin(), expected.end(), single_writer.begin()))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     single_writer_skip_list readers saw a missing or misordered element!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if versioned_skip_list snapshots keep seeing exactly their version while a writer inserts and" <<
+        "\n   removes, and if removed elements are collected once no snapshot sees them:";
+
+	{
+		constexpr unsigned reader_count = 4;
+		versioned_skip_list<unsigned long long> versioned;
+		std::multiset<unsigned long long> expected;
+		for (int i = 0; i < n; ++i)
+		{
+			versioned.Insert(input[i]);
+			expected.insert(input[i]);
+		}
+
+		std::vector<std::pair<versioned_skip_list<unsigned long long>::snapshot, std::vector<unsigned long long>>> snapshots;
+		std::atomic<bool> failed(false);
+		{
+			// readers scan the first snapshot over and over while the writer changes the list
+			const auto first = versioned.Snapshot();
+			const std::vector<unsigned long long> first_expected(expected.begin(), expected.end());
+			std::atomic<bool> writing(true);
+			std::vector<std::thread> readers;
+			for (unsigned t = 0; t < reader_count; ++t)
+				readers.emplace_back([&, t]
+				{
+					skip_list_random random(t);
+					while (writing)
+					{
+						const auto key = first_expected[random() % first_expected.size()];
+						if (!first.Contains(key) || first.Find(key) == first.end() || *first.Find(key) != key)
+							failed = true;
+						if (!std::equal(first.begin(), first.end(), first_expected.begin(), first_expected.end()))
+							failed = true;
+					}
+				});
+
+			// the writer keeps a snapshot every n writes, every one of them must stay as it was taken
+			skip_list_random random(n);
+			for (int i = 0; i < 20 * n; ++i)
+			{
+				const auto key = random() % (2 * n);
+				if (random() & 1)
+				{
+					versioned.Insert(key);
+					expected.insert(key);
+				}
+				else
+				{
+					const auto it = expected.find(key);
+					if (versioned.Remove(key) != (it != expected.end())) failed = true;
+					if (it != expected.end()) expected.erase(it);
+				}
+				if (i % n == 0)
+					snapshots.emplace_back(versioned.Snapshot(), std::vector<unsigned long long>(expected.begin(), expected.end()));
+			}
+			writing = false;
+			for (auto& reader : readers) reader.join();
+		}
+
+		for (const auto& snapshot : snapshots)
+			if (!std::equal(snapshot.first.begin(), snapshot.first.end(), snapshot.second.begin(), snapshot.second.end()))
+				failed = true;
+		const bool kept = versioned.Garbage() > 0;
+
+		// with every snapshot gone, all removed towers can be collected
+		snapshots.clear();
+		{
+			const auto latest = versioned.Snapshot();
+			versioned.Clear();
+			if (latest.Version() + 1 != versioned.Version() || versioned.Size() != 0 || versioned.begin() != versioned.end() ||
+				!std::equal(latest.begin(), latest.end(), expected.begin(), expected.end()))
+				failed = true;
+		}
+		versioned.Collect();
+		if (failed || !kept || versioned.Garbage() != 0)
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     versioned_skip_list snapshot changed or removed elements weren't collected!" << std::endl;
+			return;
+		}
+
+		// an iterator over the current version holds it like a snapshot, so collecting mid scan can't change what it sees
+		versioned_skip_list<unsigned long long> scanned;
+		for (unsigned long long i = 1; i <= 3; ++i) scanned.Insert(i);
+		{
+			auto it = scanned.begin();
+			scanned.Insert(4);
+			scanned.Remove(3);
+			scanned.Collect();
+			const auto copy = it;
+			it = scanned.end();
+			scanned.Collect();
+			std::vector<unsigned long long> seen;
+			for (auto at = copy; at != scanned.end(); ++at) seen.push_back(*at);
+			if (seen != std::vector<unsigned long long>{ 1, 2, 3 } || scanned.Garbage() != 1)
+				failed = true;
+		}
+		scanned.Collect();
+		if (failed || scanned.Garbage() != 0 || scanned.Contains(3) || !scanned.Contains(4))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     versioned_skip_list scan of the current version changed under Collect!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
+	std::cout << " - checking if sharded_skip_list matches a std::multiset through Insert(), Remove(), batches from" <<
+        "\n   several threads, and rebalancing, iterating in order across shards:";
+
+	{
+		typedef sharded_skip_list_op<unsigned long long> op;
+		sharded_skip_list<unsigned long long> sharded(4, 2);
+		std::multiset<unsigned long long> expected;
+
+		// ascending keys all land in the last shard, forcing rebalances
+		for (int i = 0; i < 20 * n; ++i)
+		{
+			sharded.Insert(i);
+			expected.insert(i);
+		}
+		bool failed = false;
+		for (size_t i = 0; i < sharded.Shards(); ++i)
+			if (sharded.ShardSize(i) > 2 * sharded.Size() / sharded.Shards()) failed = true;
+
+		// batches from several threads, each thread owning the keys that are i mod its index
+		constexpr unsigned thread_count = 4;
+		std::vector<std::vector<op>> batches(thread_count);
+		for (int i = 0; i < 20 * n; ++i)
+		{
+			auto& batch = batches[i % thread_count];
+			batch.push_back({ op::remove, static_cast<unsigned long long>(i) });
+			if (i % 3 == 0) batch.push_back({ op::insert, static_cast<unsigned long long>(i) });
+			if (i % 3 == 1) batch.push_back({ op::insert, static_cast<unsigned long long>(20 * n + i) });
+			if (i % 3 == 1) batch.push_back({ op::remove, static_cast<unsigned long long>(20 * n + i) });
+		}
+		size_t expected_changed = 0;
+		for (const auto& batch : batches)
+			for (const auto& o : batch)
+			{
+				if (o.op == op::insert) expected.insert(o.val);
+				else if (expected.find(o.val) != expected.end()) expected.erase(expected.find(o.val));
+				else continue;
+				++expected_changed;
+			}
+
+		std::atomic<size_t> changed(0);
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < thread_count; ++t) threads.emplace_back([&, t] { changed += sharded.Apply(batches[t]); });
+		for (auto& thread : threads) thread.join();
+
+		for (const auto i : input)
+		{
+			if (sharded.Remove(i) != (expected.find(i) != expected.end())) failed = true;
+			if (expected.find(i) != expected.end()) expected.erase(expected.find(i));
+		}
+
+		sharded.Rebalance();
+
+		// a run of equal keys can't be split across shards, its shard stays overfull without being rebuilt every time
+		sharded_skip_list<unsigned long long> duplicates(4, 0);
+		for (int i = 0; i < 20 * n; ++i) duplicates.Insert(i < n ? i : n);
+		if (duplicates.Rebalances() > 64 || duplicates.Size() != 20 * n || !duplicates.Contains(n) ||
+			!std::is_sorted(duplicates.begin(), duplicates.end()))
+			failed = true;
+
+		// pooled shards each get their own pool, rebuilding one shard or applying batches on several threads can't
+		// touch another shard's nodes
+		sharded_skip_list<unsigned long long, std::less<unsigned long long>, skip_list_pool_allocator<unsigned long long>> pooled(4, 3);
+		std::multiset<unsigned long long> pooled_expected;
+		for (int i = 0; i < 20 * n; ++i)
+		{
+			pooled.Insert(i);
+			pooled_expected.insert(i);
+		}
+		for (unsigned t = 0; t < thread_count; ++t)
+		{
+			pooled.Apply(batches[t]);
+			for (const auto& o : batches[t])
+			{
+				if (o.op == op::insert) pooled_expected.insert(o.val);
+				else if (pooled_expected.find(o.val) != pooled_expected.end()) pooled_expected.erase(pooled_expected.find(o.val));
+			}
+		}
+		pooled.Rebalance();
+		if (pooled.Rebalances() < 2 || !std::equal(pooled_expected.begin(), pooled_expected.end(), pooled.begin(), pooled.end()))
+			failed = true;
+
+		if (failed || changed != expected_changed || sharded.Size() != expected.size() ||
+			!std::equal(expected.begin(), expected.end(), sharded.begin(), sharded.end()) || sharded.Contains(21 * n))
+		{
+			std::cout << "   Fail!" << std::endl;
+			std::cout << "     sharded_skip_list and std::multiset differ!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "\n   Passed!\n" << std::endl;
+
 	std::cout << " Correctness test passed!" << std::endl;
 }
 
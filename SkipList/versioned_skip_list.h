@@ -0,0 +1,599 @@
+/*
+ * Multi-version skip list with point-in-time snapshots.
+ *
+ * Every write creates a new version of the list. Each tower records the version that inserted it (begin) and the
+ * version that removed it (end), and a removed tower stays linked until no snapshot can see it any more. A Snapshot()
+ * is just a version number, so taking one is O(1), and its Contains(), Find(), and iterators see exactly the elements
+ * with begin <= version < end, however long it is kept and whatever is written meanwhile.
+ *
+ * Writers take a writer lock among themselves but never wait for readers. Readers take no locks: towers are published
+ * with release stores as in single_writer_skip_list, and the towers that garbage collection unlinks are freed through
+ * epoch based reclamation (see skip_list_epoch.h). Collection runs as removals pile up and can be run with Collect().
+ *
+ * Works with any type T that defines < operator, or any strict weak ordering given as Compare.
+ *
+ * Author: Mike Greber
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "skip_list.h"
+#include "skip_list_epoch.h"
+
+
+/*
+ * Tower node for use with versioned_skip_list, with the versions that inserted and removed it. Like skip_list_node, a
+ * single allocation holding val once followed by an inline array of height atomic forward links.
+ */
+template <typename T>
+struct alignas(std::atomic<std::uintptr_t>) versioned_skip_list_node
+{
+    // version of a tower that hasn't been removed
+    static constexpr std::uint64_t live = std::numeric_limits<std::uint64_t>::max();
+
+    // constructs val in place from args
+    template <typename... Args>
+    explicit versioned_skip_list_node(unsigned height, std::uint64_t begin, Args&&... args)
+        : val(std::forward<Args>(args)...), height(height), begin(begin), end(live)
+    {
+        for (unsigned i = 0; i < height; ++i) new (links() + i) std::atomic<std::uintptr_t>(0);
+    }
+
+    const T val;
+    const unsigned height;              // number of layers this node is linked into
+    const std::uint64_t begin;          // version that inserted the node
+    std::atomic<std::uint64_t> end;     // version that removed the node, live until then
+
+    // true if the node is part of version
+    bool Visible(std::uint64_t version) const { return begin <= version && version < end.load(std::memory_order_acquire); }
+
+    // forward link of this node in layer
+    std::atomic<std::uintptr_t>& next(unsigned layer) { return links()[layer]; }
+    const std::atomic<std::uintptr_t>& next(unsigned layer) const { return links()[layer]; }
+
+    // number of bytes used by a node with height links
+    static constexpr size_t Bytes(unsigned height)
+    {
+        return sizeof(versioned_skip_list_node) + height * sizeof(std::atomic<std::uintptr_t>);
+    }
+
+private:
+    // links are stored directly after the node in the same allocation
+    std::atomic<std::uintptr_t>* links() { return reinterpret_cast<std::atomic<std::uintptr_t>*>(this + 1); }
+    const std::atomic<std::uintptr_t>* links() const { return reinterpret_cast<const std::atomic<std::uintptr_t>*>(this + 1); }
+};
+
+
+/*
+ * Ordered multiset with snapshots. Insert(), Remove(), Clear(), and Collect() can be called from any thread and are
+ * serialized. Snapshot() and reads can be called from any number of threads at once, and never wait for writers.
+ * p is the probability that an inserted element is promoted to the next higher layer.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+          typename LevelGenerator = skip_list_level_generator>
+class versioned_skip_list : private skip_list_compare<Compare>
+{
+    typedef versioned_skip_list_node<T> node;
+
+public:
+    using value_type = T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    struct iterator;
+    class snapshot;
+
+    // tallest tower, enough for about 2^32 elements at p = 1/2
+    static constexpr unsigned max_layers = 32;
+
+    // removed towers waiting for collection before Remove() starts one
+    static constexpr size_t collect_threshold = 64;
+
+    // Constructor
+    explicit versioned_skip_list(float p = 0.5, const Compare& compare = Compare(), const Allocator& allocator = Allocator());
+
+    versioned_skip_list(const versioned_skip_list&) = delete;
+    versioned_skip_list& operator=(const versioned_skip_list&) = delete;
+
+    // Destructor, no snapshot of the list or other thread may be using it
+    ~versioned_skip_list();
+
+    // returns a snapshot of the current version
+    snapshot Snapshot() const;
+
+    // returns the current version, the number of writes so far
+    std::uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+
+    // returns true if val is in the current version
+    bool Contains(const T& val) const { return FindAt(Version(), val) != end(); }
+
+    // returns an iterator to an element equal to val in the current version, or end(). The iterator keeps its version
+    // from being collected, like a snapshot, until it is destroyed
+    iterator Find(const T& val) const { return FindAt(Register(), val, true); }
+
+    // returns an iterator to the first element not less than val in the current version, or end(). The iterator keeps
+    // its version from being collected until it is destroyed
+    iterator LowerBound(const T& val) const { return LowerBoundAt(Register(), val, true); }
+
+    // inserts val as a new version
+    void Insert(const T& val) { Emplace(val); }
+    void Insert(T&& val) { Emplace(std::move(val)); }
+
+    // constructs an element in place from args and inserts it as a new version
+    template <typename... Args>
+    void Emplace(Args&&... args);
+
+    // removes one element equal to val as a new version, returns false (without a new version) if there is none
+    bool Remove(const T& val);
+
+    // removes all elements as a new version
+    void Clear();
+
+    // unlinks and frees the removed towers no snapshot can see any more, returns the number freed
+    size_t Collect();
+
+    // returns the number of elements in the current version
+    size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    // returns the number of removed towers still linked, waiting for the snapshots that can see them to go away
+    size_t Garbage() const
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return garbage_.size();
+    }
+
+    // returns the comparator ordering the elements
+    Compare key_comp() const { return this->comp(); }
+
+    // returns an iterator to the first element of the current version, which keeps its version from being collected
+    // until it is destroyed
+    iterator begin() const { return BeginAt(Register(), true); }
+
+    iterator end() const { return iterator(); }
+
+private:
+    typedef skip_list_node_storage<T> node_storage;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_storage> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    static_assert(alignof(node) <= alignof(node_storage), "node storage units must keep nodes aligned");
+
+    std::atomic<std::uintptr_t> head_[max_layers];   // first link of each layer
+    std::atomic<unsigned> layers_;                   // number of layers in use, only grows
+    std::atomic<std::uint64_t> version_;             // last committed version
+    std::atomic<size_t> size_;
+    LevelGenerator generator_;
+    mutable std::mutex write_mutex_;                 // serializes writers, guards generator_ and garbage_
+    std::vector<node*> garbage_;                     // removed towers still linked
+    size_t collect_at_;                              // garbage_ size that starts the next collection
+    mutable std::mutex snapshots_mutex_;             // guards snapshots_, and orders taking a snapshot with collection
+    mutable std::multiset<std::uint64_t> snapshots_; // versions of the live snapshots
+    node_allocator allocator_;
+    mutable skip_list_epoch epoch_;                  // destroyed before allocator_, it frees through it
+
+    std::atomic<std::uintptr_t>& Link(node* pred, unsigned layer) { return pred ? pred->next(layer) : head_[layer]; }
+    const std::atomic<std::uintptr_t>& Link(const node* pred, unsigned layer) const { return pred ? pred->next(layer) : head_[layer]; }
+
+    static node* Ptr(std::uintptr_t link) { return reinterpret_cast<node*>(link); }
+    static std::uintptr_t Bits(const node* n) { return reinterpret_cast<std::uintptr_t>(n); }
+
+    // reads of a version, the caller must be pinned
+    const node* LowerBoundNode(const T& val) const;
+
+    // reads of a version, registered if the version was registered for the returned iterator, which releases it
+    iterator BeginAt(std::uint64_t version, bool registered = false) const;
+    iterator FindAt(std::uint64_t version, const T& val, bool registered = false) const;
+    iterator LowerBoundAt(std::uint64_t version, const T& val, bool registered = false) const;
+
+    // writer: fills up with the last node before val in each layer in use
+    void FindPath(const T& val, node** up);
+
+    // writer: unlinks n from every layer, from the top down
+    void Unlink(node* n);
+
+    // registers the current version, keeping it from being collected until released, and returns it
+    std::uint64_t Register() const;
+
+    // registers version again for a copy of something holding it
+    void Register(std::uint64_t version) const
+    {
+        std::lock_guard<std::mutex> lock(snapshots_mutex_);
+        snapshots_.insert(version);
+    }
+
+    void Release(std::uint64_t version) const
+    {
+        std::lock_guard<std::mutex> lock(snapshots_mutex_);
+        snapshots_.erase(snapshots_.find(version));
+    }
+
+    template <typename... Args>
+    node* CreateNode(unsigned height, Args&&... args);
+    void DestroyNode(node* n);
+    static size_t NodeUnits(unsigned height) { return (node::Bytes(height) + sizeof(node_storage) - 1) / sizeof(node_storage); }
+
+    // reclaim function for epoch_, context is the list
+    static void Reclaim(void* context, void* object) { static_cast<versioned_skip_list*>(context)->DestroyNode(static_cast<node*>(object)); }
+
+    bool Less(const T& a, const T& b) const { return this->comp()(a, b); }
+
+public:
+    /*
+     * Forward read only iterator over the elements of one version. Keeps the creating thread pinned while it exists, so
+     * it stays valid however the list changes, and must not be passed to another thread. Iterators over the current
+     * version also keep it registered, as a snapshot does, so collection can't unlink towers they would still visit.
+     */
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator() : node_(nullptr), version_(0), registered_(nullptr) {}
+
+        iterator(const iterator& other)
+            : node_(other.node_), version_(other.version_), guard_(other.guard_), registered_(other.registered_)
+        {
+            if (registered_) registered_->Register(version_);
+        }
+
+        iterator(iterator&& other) noexcept
+            : node_(other.node_), version_(other.version_), guard_(std::move(other.guard_)), registered_(other.registered_)
+        {
+            other.registered_ = nullptr;
+        }
+
+        iterator& operator=(iterator other) noexcept
+        {
+            std::swap(node_, other.node_);
+            std::swap(version_, other.version_);
+            std::swap(guard_, other.guard_);
+            std::swap(registered_, other.registered_);
+            return *this;
+        }
+
+        ~iterator() { if (registered_) registered_->Release(version_); }
+
+        const T& operator*() const { return node_->val; }
+        const T* operator->() const { return &node_->val; }
+
+        // Prefix increment
+        iterator& operator++() { node_ = Skip(Ptr(node_->next(0).load(std::memory_order_acquire)), version_); return *this; }
+
+        // Postfix increment
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const iterator& a, const iterator& b) { return a.node_ == b.node_; }
+        friend bool operator!= (const iterator& a, const iterator& b) { return a.node_ != b.node_; }
+
+    private:
+        friend class versioned_skip_list;
+
+        iterator(const node* n, std::uint64_t version, skip_list_epoch::guard guard, const versioned_skip_list* registered)
+            : node_(Skip(n, version)), version_(version), guard_(std::move(guard)), registered_(registered) {}
+
+        // returns the first node from n that is part of version
+        static const node* Skip(const node* n, std::uint64_t version)
+        {
+            while (n && !n->Visible(version)) n = Ptr(n->next(0).load(std::memory_order_acquire));
+            return n;
+        }
+
+        const node* node_;
+        std::uint64_t version_;
+        skip_list_epoch::guard guard_;
+        const versioned_skip_list* registered_;   // list version_ is registered with, if the iterator holds it
+    };
+
+    /*
+     * Read only view of one version of the list. Keeps that version from being collected until it is destroyed. Can be
+     * moved to and used from any thread, but must not outlive the list.
+     */
+    class snapshot
+    {
+    public:
+        snapshot(snapshot&& other) noexcept : list_(other.list_), version_(other.version_) { other.list_ = nullptr; }
+        snapshot& operator=(snapshot other) noexcept { std::swap(list_, other.list_); std::swap(version_, other.version_); return *this; }
+        ~snapshot() { if (list_) list_->Release(version_); }
+
+        // returns the version the snapshot sees
+        std::uint64_t Version() const { return version_; }
+
+        bool Contains(const T& val) const { return Find(val) != end(); }
+        iterator Find(const T& val) const { return list_->FindAt(version_, val); }
+        iterator LowerBound(const T& val) const { return list_->LowerBoundAt(version_, val); }
+
+        iterator begin() const { return list_->BeginAt(version_); }
+
+        iterator end() const { return iterator(); }
+
+    private:
+        friend class versioned_skip_list;
+
+        snapshot(const versioned_skip_list* list, std::uint64_t version) : list_(list), version_(version) {}
+
+        const versioned_skip_list* list_;
+        std::uint64_t version_;
+    };
+};
+
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::versioned_skip_list(const float p, const Compare& compare,
+                                                                               const Allocator& allocator)
+    : skip_list_compare<Compare>(compare), layers_(1), version_(0), size_(0), generator_(p), collect_at_(collect_threshold),
+      allocator_(allocator), epoch_(Reclaim, this)
+{
+    for (auto& link : head_) link.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * Removed towers that haven't been collected are still linked, so walking the bottom layer frees them too.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::~versioned_skip_list()
+{
+    auto current = Ptr(head_[0].load(std::memory_order_relaxed));
+    while (current)
+    {
+        const auto next = Ptr(current->next(0).load(std::memory_order_relaxed));
+        DestroyNode(current);
+        current = next;
+    }
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+typename versioned_skip_list<T, Compare, Allocator, LevelGenerator>::snapshot
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Snapshot() const
+{
+    return snapshot(this, Register());
+}
+
+/*
+ * The version is read and registered under the same lock collection reads the oldest snapshot under, so a collection
+ * either sees the new registration or finished with an oldest version no later than it.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+std::uint64_t versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Register() const
+{
+    std::lock_guard<std::mutex> lock(snapshots_mutex_);
+    const auto version = version_.load(std::memory_order_acquire);
+    snapshots_.insert(version);
+    return version;
+}
+
+/*
+ * Search over every linked tower, removed ones included, they are still in order.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+const versioned_skip_list_node<T>* versioned_skip_list<T, Compare, Allocator, LevelGenerator>::LowerBoundNode(const T& val) const
+{
+    const node* pred = nullptr;
+    const node* current = nullptr;
+    for (auto layer = layers_.load(std::memory_order_acquire); layer-- > 0;)
+    {
+        current = Ptr(Link(pred, layer).load(std::memory_order_acquire));
+        while (current && Less(current->val, val))
+        {
+            pred = current;
+            current = Ptr(current->next(layer).load(std::memory_order_acquire));
+        }
+    }
+    return current;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+typename versioned_skip_list<T, Compare, Allocator, LevelGenerator>::iterator
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::BeginAt(const std::uint64_t version, const bool registered) const
+{
+    iterator it(nullptr, version, skip_list_epoch::guard(), registered ? this : nullptr);
+    auto guard = epoch_.Pin();
+    return iterator(Ptr(head_[0].load(std::memory_order_acquire)), version, std::move(guard), std::exchange(it.registered_, nullptr));
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+typename versioned_skip_list<T, Compare, Allocator, LevelGenerator>::iterator
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::LowerBoundAt(const std::uint64_t version, const T& val,
+                                                                         const bool registered) const
+{
+    // releases the registration if the search throws
+    iterator it(nullptr, version, skip_list_epoch::guard(), registered ? this : nullptr);
+    auto guard = epoch_.Pin();
+    return iterator(LowerBoundNode(val), version, std::move(guard), std::exchange(it.registered_, nullptr));
+}
+
+/*
+ * Equal towers of other versions may come first, so the search steps over them to the one in version.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+typename versioned_skip_list<T, Compare, Allocator, LevelGenerator>::iterator
+versioned_skip_list<T, Compare, Allocator, LevelGenerator>::FindAt(const std::uint64_t version, const T& val,
+                                                                   const bool registered) const
+{
+    auto it = LowerBoundAt(version, val, registered);
+    if (it != end() && !Less(val, *it)) return it;
+    return end();
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void versioned_skip_list<T, Compare, Allocator, LevelGenerator>::FindPath(const T& val, node** up)
+{
+    node* pred = nullptr;
+    for (auto layer = layers_.load(std::memory_order_relaxed); layer-- > 0;)
+    {
+        for (auto next = Ptr(Link(pred, layer).load(std::memory_order_relaxed)); next && Less(next->val, val);
+             next = Ptr(next->next(layer).load(std::memory_order_relaxed)))
+            pred = next;
+        up[layer] = pred;
+    }
+}
+
+/*
+ * The tower is stamped with the new version before it is published, so readers of older versions skip it until the
+ * version is committed.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+template <typename... Args>
+void versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Emplace(Args&&... args)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    const auto version = version_.load(std::memory_order_relaxed) + 1;
+    const auto height = generator_(max_layers);
+    auto new_node = CreateNode(height, version, std::forward<Args>(args)...);
+
+    if (layers_.load(std::memory_order_relaxed) < height) layers_.store(height, std::memory_order_release);
+
+    node* up[max_layers];
+    FindPath(new_node->val, up);
+
+    for (unsigned layer = 0; layer < height; ++layer)
+        new_node->next(layer).store(Link(up[layer], layer).load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (unsigned layer = 0; layer < height; ++layer)
+        Link(up[layer], layer).store(Bits(new_node), std::memory_order_release);
+
+    size_.fetch_add(1, std::memory_order_relaxed);
+    version_.store(version, std::memory_order_release);
+}
+
+/*
+ * Stamps the first live equal tower with the new version, leaving it linked for the snapshots that still see it.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+bool versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Remove(const T& val)
+{
+    bool collect;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        node* up[max_layers];
+        FindPath(val, up);
+
+        auto victim = Ptr(Link(up[0], 0).load(std::memory_order_relaxed));
+        while (victim && !Less(val, victim->val) && victim->end.load(std::memory_order_relaxed) != node::live)
+            victim = Ptr(victim->next(0).load(std::memory_order_relaxed));
+        if (!victim || Less(val, victim->val)) return false;
+
+        const auto version = version_.load(std::memory_order_relaxed) + 1;
+        victim->end.store(version, std::memory_order_release);
+        garbage_.push_back(victim);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        version_.store(version, std::memory_order_release);
+        collect = garbage_.size() >= collect_at_;
+    }
+
+    if (collect) Collect();
+    return true;
+}
+
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        const auto version = version_.load(std::memory_order_relaxed) + 1;
+        for (auto n = Ptr(head_[0].load(std::memory_order_relaxed)); n; n = Ptr(n->next(0).load(std::memory_order_relaxed)))
+        {
+            if (n->end.load(std::memory_order_relaxed) != node::live) continue;
+            n->end.store(version, std::memory_order_release);
+            garbage_.push_back(n);
+        }
+        size_.store(0, std::memory_order_relaxed);
+        version_.store(version, std::memory_order_release);
+    }
+    Collect();
+}
+
+/*
+ * A removed tower is invisible to every snapshot once its end version is no later than the oldest one, and snapshots
+ * taken from now on are later still. Those towers are unlinked and retired, the rest wait for the next collection,
+ * which starts once as many more have been removed.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+size_t versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Collect()
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    auto guard = epoch_.Pin();
+
+    std::uint64_t oldest;
+    {
+        std::lock_guard<std::mutex> snapshots_lock(snapshots_mutex_);
+        oldest = snapshots_.empty() ? version_.load(std::memory_order_relaxed) : *snapshots_.begin();
+    }
+
+    size_t collected = 0;
+    std::vector<node*> kept;
+    for (const auto n : garbage_)
+    {
+        if (n->end.load(std::memory_order_relaxed) > oldest)
+        {
+            kept.push_back(n);
+            continue;
+        }
+        Unlink(n);
+        epoch_.Retire(n);
+        ++collected;
+    }
+    garbage_.swap(kept);
+    collect_at_ = garbage_.size() + collect_threshold;
+    return collected;
+}
+
+/*
+ * Towers equal to n are adjacent in every layer, so from the last node before them the search walks to n itself.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void versioned_skip_list<T, Compare, Allocator, LevelGenerator>::Unlink(node* n)
+{
+    node* up[max_layers];
+    FindPath(n->val, up);
+
+    for (auto layer = n->height; layer-- > 0;)
+    {
+        auto pred = up[layer];
+        for (auto next = Ptr(Link(pred, layer).load(std::memory_order_relaxed)); next != n;
+             next = Ptr(next->next(layer).load(std::memory_order_relaxed)))
+            pred = next;
+        Link(pred, layer).store(n->next(layer).load(std::memory_order_relaxed), std::memory_order_release);
+    }
+}
+
+/*
+ * Allocates storage for a tower node with room for height links from the allocator and constructs the node in it,
+ * forwarding args to the constructor of its value.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+template <typename... Args>
+versioned_skip_list_node<T>* versioned_skip_list<T, Compare, Allocator, LevelGenerator>::CreateNode(unsigned height, Args&&... args)
+{
+    const auto units = NodeUnits(height);
+    auto memory = node_traits::allocate(allocator_, units);
+    try { return new (static_cast<void*>(memory)) node(height, std::forward<Args>(args)...); }
+    catch (...) { node_traits::deallocate(allocator_, memory, units); throw; }
+}
+
+/*
+ * Destroys a node created with CreateNode() and returns its storage to the allocator.
+ */
+template <typename T, typename Compare, typename Allocator, typename LevelGenerator>
+void versioned_skip_list<T, Compare, Allocator, LevelGenerator>::DestroyNode(node* n)
+{
+    const auto units = NodeUnits(n->height);
+    n->~node();
+    node_traits::deallocate(allocator_, reinterpret_cast<node_storage*>(n), units);
+}